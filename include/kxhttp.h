@@ -5,6 +5,20 @@
 
 #include "cli11/CLI11.hpp"
 #include "httplib/httplib.h"
+#include "kxhttp/headers.h"
+#include "kxhttp/histogram.h"
+#include "kxhttp/url.h"
+#include "kxhttp/wire.h"
+#include "kxhttp/template.h"
+#include "kxhttp/bench.h"
+#include "kxhttp/pool.h"
+#include "kxhttp/daemon.h"
+#include "kxhttp/frame.h"
+#include "kxhttp/agent.h"
+#include "kxhttp/ratelimit.h"
+#include "kxhttp/hedge.h"
+#include "kxhttp/retry.h"
+#include "kxhttp/output.h"
 
 #define KXHTTP_VER "0.1.0"
 
@@ -32,45 +46,117 @@ namespace KxHTTP
         std::vector<std::string> formFiles;
         std::vector<std::string> jsonData;
         std::string jsonFile;
+        std::string dataBinary; // Raw body, or @path for a file
         std::vector<std::string> headers;
         std::vector<std::string> cookies;
         std::string authData; // Basic Auth
         std::string authDigest;
         std::string authBearerToken;
         std::string outputFile;
+        std::string unixSocket;
+        ConnectionOptions connection;
+        OutputFormat format = OUTPUT_TEXT;
+        bool summary = false; // Count the body instead of keeping and printing it
     };
 
     class HTTPRequest
     {
         public:
-            explicit HTTPRequest(RequestData& rd);
+            explicit HTTPRequest(RequestData&& rd);
+            // The prototype's headers and body sent to another URL, see preparePayload()
+            HTTPRequest(const HTTPRequest& prototype, const std::string& url);
             ~HTTPRequest();
             void sendRequest();
-            void processResponse() const;
+            void sendRequest(ConnectionPool& pool);
+            void processResponse(std::ostream& out) const;
+            // A request that failed, as a --format json or jsonl record
+            void processError(std::ostream& out, const std::string& message) const;
+            RequestTemplate compile();
+
+            // Builds the headers and body ahead of the first send, so copies share them
+            void preparePayload();
 
         private:
-            void sendGET(httplib::Client *cli);
-            void sendPOST(httplib::Client *cli);
-            void sendPUT(httplib::Client *cli);
-            void sendDELETE(httplib::Client *cli);
-            void sendPATCH(httplib::Client *cli);
-            void sendOPTIONS(httplib::Client *cli);
-            void sendHEAD(httplib::Client *cli);
+            void prepare();
+            void preparePOST();
+            void preparePUT();
+            void preparePATCH();
 
             RequestData requestData;
-            httplib::Result result;
+            Body jsonBody;
+            Endpoint endpoint;
+            Request outgoing;
+            Response response;
             bool fileOutputStatus;
-            bool authTypeDefined;
-            httplib::Headers constructHeaders();
-            void setAuth(httplib::Client *cli);
-            void handleFileOutput();
+            bool requestSent; // Bytes of the current attempt reached the socket
+            bool hedged; // The current attempt also went out on a second connection
+            std::string digestAuthorization; // Answer to this attempt's Digest challenge, if any
+            ConnectionPool *pool; // Where a hedged duplicate's connection comes from, if set
+            Connection::Deadline deadline; // From --max-time, shared by every attempt
+            ResponseTiming timing;
+            unsigned attempts;
+            uint64_t bodyBytes;
+            bool payloadReady;
+            ResultRecord record() const;
+            void printSummary(std::ostream& out) const;
+            HeaderList constructHeaders();
+            void setAuth(HeaderList& headers);
+            const Body& jsonPayload();
+            Body binaryPayload();
+            void setBody(Body body, std::string_view contentType);
+            bool isIdempotent() const; // Safe to send again once it reached the server
+            void withRetries(const std::function<void()>& attempt);
+            void serializeHead(std::string& out, const Endpoint& endpoint) const;
+            void exchange(std::unique_ptr<Connection>& conn);
+            void hedge(std::unique_ptr<Connection>& conn);
+            bool handleFileOutput(Connection& conn);
+    };
+
+    // Reads requests line by line and sends them against a base URL, reusing
+    // connections between lines. Options given to the shell apply to every line.
+    class Shell
+    {
+        public:
+            Shell(const std::string& baseUrl, RequestData&& defaults);
+            void run(std::istream& in);
+
+        private:
+            // What the line prints on stdout, errors go straight to stderr
+            std::string execute(const std::string& line);
+            RequestData parseLine(const std::string& line, std::string& methodStr);
+            std::string resolveUrl(const std::string& target) const;
+
+            std::string baseUrl;
+            RequestData defaults;
+            ConnectionPool pool;
+    };
+
+    // Sends the same request to several URLs, a few at a time over shared
+    // connections, and prints the results in input order or as they finish
+    class FanOut
+    {
+        public:
+            FanOut(RequestData&& base, std::vector<std::string> urls, unsigned parallel, bool ordered = true);
+            void run(std::ostream& out);
+
+        private:
+            std::unique_ptr<HTTPRequest> prototype;
+            OutputFormat format;
+            bool summary;
+            std::vector<std::string> urls;
+            unsigned parallel;
+            bool ordered;
+            ConnectionPool pool;
     };
 
     // Utilities
+    void addRequestTarget(CLI::App *app, RequestData& request, std::string& methodStr);
+    void addRequestOptions(CLI::App *app, RequestData& request);
+    CLI::AsNumberWithUnit durationTransformer();
     Method stringToMethod(std::string& m);
     std::string methodToString(Method m);
-    std::string getPathFromUrl(const std::string &url);
-    std::string getProtocolAndDomain(const std::string &url);
+    Url parseRequestUrl(const std::string &url);
+    Endpoint endpointFromUrl(const Url &url);
 }
 
 
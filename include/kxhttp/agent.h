@@ -0,0 +1,60 @@
+#ifndef KXHTTP_AGENT_H
+#define KXHTTP_AGENT_H
+
+#include <string>
+#include <vector>
+
+#include "kxhttp/bench.h"
+
+// Bumped whenever the job or result layout changes
+#define KXHTTP_AGENT_PROTOCOL 3
+
+#ifndef KXHTTP_AGENT_PORT
+#define KXHTTP_AGENT_PORT 7879
+#endif
+
+// Largest job or result frame exchanged with an agent
+#ifndef KXHTTP_AGENT_MAX_FRAME
+#define KXHTTP_AGENT_MAX_FRAME uint32_t(64u * 1024u * 1024u)
+#endif
+
+// How long either side waits for the other before and between runs
+#ifndef KXHTTP_AGENT_HANDSHAKE_SECOND
+#define KXHTTP_AGENT_HANDSHAKE_SECOND 30
+#endif
+
+namespace KxHTTP
+{
+    struct RequestData;
+
+    // A load generator that runs bench jobs sent by a coordinator over TCP,
+    // one at a time, and sends back mergeable histograms instead of a report.
+    // Jobs must present the agent's token.
+    class BenchAgent
+    {
+        public:
+            BenchAgent(const std::string& address, const std::string& token);
+            ~BenchAgent();
+            BenchAgent(const BenchAgent&) = delete;
+            BenchAgent& operator=(const BenchAgent&) = delete;
+
+            void run();
+
+        private:
+            void serve(int client);
+
+            std::string address;
+            std::string token;
+            int listener;
+    };
+
+    // Splits a bench across agents ("host[:port]"): the request count, each
+    // stage's rate and the --max-rps limits are divided between them,
+    // --concurrency applies per agent.
+    // All agents start together and their results are merged into one report.
+    // scenarioText holds a scenario file's lines, or is empty for the single request.
+    void runOnAgents(const std::vector<std::string>& agents, const std::string& token, const RequestData& request,
+                     const std::string& scenarioText, const BenchOptions& options);
+}
+
+#endif // KXHTTP_AGENT_H
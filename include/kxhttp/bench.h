@@ -0,0 +1,147 @@
+#ifndef KXHTTP_BENCH_H
+#define KXHTTP_BENCH_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "kxhttp/histogram.h"
+#include "kxhttp/template.h"
+
+// Share of failed requests above which a --find-max probe counts as a breach
+#ifndef KXHTTP_FIND_MAX_ERROR_RATE
+#define KXHTTP_FIND_MAX_ERROR_RATE 0.01
+#endif
+
+// --find-max stops bisecting once the bounds are this close, relative to the lower one
+#ifndef KXHTTP_FIND_MAX_PRECISION
+#define KXHTTP_FIND_MAX_PRECISION 0.05
+#endif
+
+// Upper bound on the number of --find-max probes
+#ifndef KXHTTP_FIND_MAX_PROBES
+#define KXHTTP_FIND_MAX_PROBES 20
+#endif
+
+namespace KxHTTP
+{
+    struct FrameReader;
+    struct RequestData;
+
+    // A stretch of a load profile: the request rate moves linearly from the
+    // previous stage's rate to this one over the given time
+    struct BenchStage
+    {
+        double rate = 0; // requests per second
+        double seconds = 0;
+    };
+
+    struct BenchOptions
+    {
+        uint64_t requests = 1000;
+        unsigned concurrency = 10;
+        std::vector<BenchStage> stages; // Open-loop, rate-driven run instead of a request count
+        bool rampFromZero = false;      // The first stage climbs from 0 instead of starting at its rate
+    };
+
+    // "100:30s,2000:60s,2000:30s" -> hold 100 rps for 30s, ramp to 2000 over 60s, hold for 30s
+    std::vector<BenchStage> parseStages(const std::string& spec);
+
+    // A latency objective, e.g. "p99<50ms" or "p99.9<=1s"
+    struct BenchSlo
+    {
+        double quantile = 0.99;
+        double limitMs = 0;
+    };
+
+    BenchSlo parseSlo(const std::string& spec);
+
+    struct FindMaxOptions
+    {
+        BenchSlo slo;
+        double startRate = 10;
+        double probeSeconds = 10;
+    };
+
+    // One kind of request in a load mix. Scenarios without their own
+    // concurrency share the bench's workers and are picked by weight,
+    // the others get that many dedicated workers.
+    struct BenchScenario
+    {
+        std::string name;
+        RequestTemplate requestTemplate;
+        unsigned weight = 1;
+        double thinkMs = 0;
+        unsigned concurrency = 0;
+    };
+
+    // Reads a scenario file: one request per line, in kxh's own syntax, plus
+    // --weight, --think, --concurrency and --name. Connection options and
+    // headers from the command line apply to every line.
+    std::vector<BenchScenario> loadScenarios(const std::string& path, const RequestData& defaults);
+    std::vector<BenchScenario> parseScenarios(std::istream& input, const std::string& source, const RequestData& defaults);
+
+    // Replays compiled requests over a fixed set of keep-alive connections
+    class Bench
+    {
+        public:
+            Bench(const RequestTemplate& tpl, const BenchOptions& options);
+            Bench(std::vector<BenchScenario> scenarios, const BenchOptions& options);
+            void run();
+            void printReport() const;
+
+            LatencyHistogram latency() const;
+            uint64_t failures() const;
+            double elapsed() const;
+
+            // What an agent sends back, and how the coordinator folds it into its report
+            void encodeResults(std::string& out) const;
+            void addResults(FrameReader& in);
+
+        private:
+            struct WorkerStats
+            {
+                std::vector<LatencyHistogram> latencies; // per scenario
+                std::vector<LatencyHistogram> stageLatencies;
+                std::vector<uint64_t> stageErrors;
+                std::map<int, uint64_t> statusCounts;
+                uint64_t errors = 0;
+                uint64_t bodyBytes = 0;
+            };
+
+            struct WorkerGroup
+            {
+                std::vector<size_t> scenarios;
+                std::vector<uint64_t> cumulativeWeights;
+            };
+
+            void worker(const WorkerGroup& group, WorkerStats& stats);
+            double scheduledAt(uint64_t sequence, size_t& stage) const;
+            void printStages() const;
+
+            std::vector<BenchScenario> scenarios;
+            std::vector<size_t> endpointSlots; // scenarios hitting the same endpoint share a connection
+            std::vector<WorkerGroup> groups;
+            std::vector<size_t> workerGroups;  // group index of every worker
+            BenchOptions options;
+            std::vector<double> stageFrom;  // rate at the start of each stage
+            std::vector<double> stageCount; // requests scheduled before each stage
+            std::vector<double> stageTime;  // seconds into the run each stage starts
+            std::chrono::steady_clock::time_point startTime;
+            std::atomic<uint64_t> issued;
+            std::vector<WorkerStats> workerStats;
+            double elapsedSeconds;
+            unsigned agents; // remote runs merged in by addResults()
+    };
+
+    // Holds constant rates for a probe each, doubling until the SLO breaks and then
+    // bisecting, and returns the highest rate that kept it (0 if none did)
+    double findMaxRate(const std::vector<BenchScenario>& scenarios, const BenchOptions& options,
+                       const FindMaxOptions& search);
+}
+
+#endif // KXHTTP_BENCH_H
@@ -0,0 +1,86 @@
+#ifndef KXHTTP_BODY_H
+#define KXHTTP_BODY_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef _WIN32
+struct iovec
+{
+    void *iov_base;
+    size_t iov_len;
+};
+#else
+#include <sys/uio.h>
+#endif
+
+namespace KxHTTP
+{
+    // A read-only view of a whole file. On POSIX the file is mmap'd, so its
+    // pages are written to the socket without being copied into our buffers.
+    class MappedFile
+    {
+        public:
+            explicit MappedFile(const std::string& path);
+            ~MappedFile();
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            const char *data() const;
+            size_t size() const;
+            int descriptor() const;
+
+        private:
+#ifdef _WIN32
+            std::string contents;
+#else
+            int fd;
+            void *addr;
+            size_t length;
+#endif
+    };
+
+    // Request payload, made of in-memory parts and mapped files. Copies share
+    // the same parts, so a body is never duplicated once it has been built.
+    class Body
+    {
+        public:
+            struct Part
+            {
+                std::string bytes;
+                std::shared_ptr<const MappedFile> file;
+            };
+
+            Body() = default;
+            explicit Body(std::string data);
+
+            void append(std::string data);
+            void appendFile(std::shared_ptr<const MappedFile> file);
+
+            size_t size() const;
+            bool empty() const;
+
+            // A single in-memory buffer (or nothing), which view() then returns
+            bool isContiguous() const;
+            std::string_view view() const;
+
+            // Appends one iovec per part, pointing straight at the owned bytes
+            void gather(std::vector<struct iovec>& iov) const;
+
+            // Copies everything into one string, only for the rare paths that need it
+            std::string flatten() const;
+
+            // Read-only access for writers that treat files differently, e.g. sendfile()
+            const std::vector<Part>& getParts() const;
+
+        private:
+            std::vector<Part>& mutableParts();
+
+            std::shared_ptr<std::vector<Part>> parts;
+            size_t length = 0;
+    };
+}
+
+#endif // KXHTTP_BODY_H
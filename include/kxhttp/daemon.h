@@ -0,0 +1,55 @@
+#ifndef KXHTTP_DAEMON_H
+#define KXHTTP_DAEMON_H
+
+#include <ostream>
+#include <string>
+
+#include "kxhttp/pool.h"
+
+// Bumped whenever the forwarded request or reply layout changes
+#define KXHTTP_DAEMON_PROTOCOL 3
+
+// Largest request or reply frame exchanged with the daemon
+#ifndef KXHTTP_DAEMON_MAX_FRAME
+#define KXHTTP_DAEMON_MAX_FRAME uint32_t(256u * 1024u * 1024u)
+#endif
+
+// Output sent back per reply frame, a reply spans as many frames as it needs
+#ifndef KXHTTP_DAEMON_REPLY_CHUNK
+#define KXHTTP_DAEMON_REPLY_CHUNK size_t(1024u * 1024u)
+#endif
+
+namespace KxHTTP
+{
+    struct RequestData;
+
+    // $KXH_DAEMON_SOCKET, else $XDG_RUNTIME_DIR/kxh.sock, else /tmp/kxh-<uid>.sock
+    std::string daemonSocketPath();
+
+    // A long-running process that serves requests forwarded by other kxh
+    // invocations, so they skip startup, CA loading, DNS and handshakes
+    class Daemon
+    {
+        public:
+            explicit Daemon(const std::string& socketPath);
+            ~Daemon();
+            Daemon(const Daemon&) = delete;
+            Daemon& operator=(const Daemon&) = delete;
+
+            void run();
+
+        private:
+            void serve(int client);
+
+            std::string socketPath;
+            int listener;
+            ConnectionPool pool;
+    };
+
+    // Sends the request to a running daemon and writes its output to out as it
+    // arrives. Returns false when there is no daemon to talk to, so the caller
+    // runs the request itself. error is set when the request failed.
+    bool forwardToDaemon(const RequestData& rd, std::ostream& out, std::string& error);
+}
+
+#endif // KXHTTP_DAEMON_H
@@ -0,0 +1,48 @@
+#ifndef KXHTTP_FRAME_H
+#define KXHTTP_FRAME_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace KxHTTP
+{
+    struct RequestData;
+
+    // Little-endian fields for the length-prefixed frames kxh processes
+    // exchange, e.g. with the daemon or with bench agents
+    void putU32(std::string& out, uint32_t v);
+    void putU64(std::string& out, uint64_t v);
+    void putDouble(std::string& out, double v);
+    void putString(std::string& out, const std::string& s);
+    void putStrings(std::string& out, const std::vector<std::string>& list);
+
+    // First field of every reply the daemon and bench agents send. REPLY_MORE
+    // carries part of the daemon's output, with more frames to follow.
+    enum ReplyStatus : uint32_t { REPLY_OK, REPLY_ERROR, REPLY_INCOMPATIBLE, REPLY_MORE };
+
+    // Reads back what the put* helpers wrote, throwing on a truncated frame
+    struct FrameReader
+    {
+        std::string_view in;
+        size_t pos = 0;
+
+        uint32_t u32();
+        uint64_t u64();
+        double f64();
+        std::string string();
+        std::vector<std::string> strings();
+    };
+
+    // Relative file paths are made absolute, the other end may run elsewhere
+    void encodeRequestData(std::string& out, const RequestData& rd);
+    RequestData decodeRequestData(FrameReader& in);
+
+#ifndef _WIN32
+    bool sendFrame(int fd, const std::string& payload);
+    bool receiveFrame(int fd, std::string& payload, uint32_t maxSize);
+#endif
+}
+
+#endif // KXHTTP_FRAME_H
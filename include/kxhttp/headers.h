@@ -0,0 +1,86 @@
+#ifndef KXHTTP_HEADERS_H
+#define KXHTTP_HEADERS_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Number of headers a HeaderList holds before spilling to the heap
+#ifndef KXHTTP_HEADER_INLINE_CAPACITY
+#define KXHTTP_HEADER_INLINE_CAPACITY 16
+#endif
+
+// Bytes of header text an Arena holds before spilling to the heap
+#ifndef KXHTTP_ARENA_INLINE_SIZE
+#define KXHTTP_ARENA_INLINE_SIZE 1024
+#endif
+
+namespace KxHTTP
+{
+    // Bump allocator for header text. The first block lives inline, so a
+    // typical request or response head never touches the heap at all.
+    class Arena
+    {
+        public:
+            Arena() = default;
+            Arena(const Arena&) = delete;
+            Arena& operator=(const Arena&) = delete;
+
+            std::string_view store(std::string_view s);
+            std::string_view storeLower(std::string_view s);
+            void clear();
+
+        private:
+            char *allocate(size_t n);
+
+            char inlineBlock[KXHTTP_ARENA_INLINE_SIZE];
+            std::vector<std::unique_ptr<char[]>> blocks;
+            char *cursor = inlineBlock;
+            size_t remaining = KXHTTP_ARENA_INLINE_SIZE;
+    };
+
+    struct Header
+    {
+        std::string_view name;
+        std::string_view lowerName; // Used for case-insensitive lookups
+        std::string_view value;
+    };
+
+    // Flat, insertion-ordered header container. Names and values are copied
+    // into an arena once; lookups compare against the pre-lowercased name.
+    class HeaderList
+    {
+        public:
+            HeaderList() = default;
+            HeaderList(const HeaderList& other);
+            HeaderList& operator=(const HeaderList& other);
+
+            void add(std::string_view name, std::string_view value);
+            bool has(std::string_view name) const;
+            std::string_view get(std::string_view name, std::string_view def = {}) const;
+            size_t count(std::string_view name) const;
+            void clear();
+
+            // Appends "Name: value\r\n" for every header
+            void serialize(std::string& out) const;
+
+            const Header *begin() const { return this->items; }
+            const Header *end() const { return this->items + this->length; }
+            size_t size() const { return this->length; }
+            bool empty() const { return this->length == 0; }
+
+        private:
+            Arena arena;
+            Header inlineItems[KXHTTP_HEADER_INLINE_CAPACITY];
+            std::vector<Header> heapItems;
+            Header *items = inlineItems;
+            size_t length = 0;
+    };
+
+    // Case-insensitive comparison of `s` against an already lowercased name
+    bool equalsLower(std::string_view lowerName, std::string_view s);
+}
+
+#endif // KXHTTP_HEADERS_H
@@ -0,0 +1,44 @@
+#ifndef KXHTTP_HEDGE_H
+#define KXHTTP_HEDGE_H
+
+#include <mutex>
+#include <string>
+
+#include "kxhttp/histogram.h"
+
+// Latencies a percentile --hedge-after needs before it starts hedging
+#ifndef KXHTTP_HEDGE_MIN_SAMPLES
+#define KXHTTP_HEDGE_MIN_SAMPLES 20
+#endif
+
+namespace KxHTTP
+{
+    // When a GET or HEAD is worth duplicating: after a fixed delay, or after
+    // a percentile of the latencies seen so far in this process
+    class HedgePolicy
+    {
+        public:
+            // "50ms", "p95", or "p95,200ms" to hedge after 200ms until there are enough samples
+            void configure(const std::string& spec);
+            bool enabled() const;
+
+            // A percentile without a fallback, which does nothing for the first requests
+            bool needsSamples() const;
+
+            // Milliseconds to wait for the first response, -1 for no hedging yet
+            int delayMs() const;
+            void record(uint32_t micros);
+
+        private:
+            double fixedMs = -1;
+            double quantile = 0;
+            double fallbackMs = -1;
+            mutable std::mutex mutex;
+            LatencyHistogram observed;
+    };
+
+    // The process-wide policy from --hedge-after
+    HedgePolicy& hedgePolicy();
+}
+
+#endif // KXHTTP_HEDGE_H
@@ -0,0 +1,59 @@
+#ifndef KXHTTP_HISTOGRAM_H
+#define KXHTTP_HISTOGRAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Sub-buckets per power of two, values are kept to within 1/128 (< 1%)
+#define KXHTTP_HISTOGRAM_SUB_BUCKETS 128
+
+namespace KxHTTP
+{
+    struct FrameReader;
+
+    // Log-linear latency histogram in microseconds, in the spirit of
+    // HdrHistogram: fixed memory, constant-time record, and two histograms
+    // merge by adding their counts, so per-worker histograms combine exactly.
+    class LatencyHistogram
+    {
+        public:
+            LatencyHistogram();
+
+            void record(uint32_t micros);
+            void merge(const LatencyHistogram& other);
+            void clear();
+
+            uint64_t count() const;
+            uint32_t min() const;
+            uint32_t max() const;
+            double mean() const;
+            uint32_t percentile(double p) const; // p in [0, 1]
+
+            // Sparse wire form, non-empty buckets only, so remote runs can be merged here
+            void serialize(std::string& out) const;
+            void deserialize(FrameReader& in);
+
+            // Recorded values with the bucket counts as (value, count) pairs, for reports
+            template <typename F> void forEach(F&& f) const
+            {
+                for (size_t i = 0; i < this->counts.size(); i++) {
+                    if (this->counts[i] != 0)
+                        f(valueAt(i), this->counts[i]);
+                }
+            }
+
+        private:
+            static size_t indexOf(uint32_t micros);
+            static uint32_t valueAt(size_t index);
+
+            std::vector<uint64_t> counts;
+            uint64_t total;
+            uint64_t sum;
+            uint32_t lowest;
+            uint32_t highest;
+    };
+}
+
+#endif // KXHTTP_HISTOGRAM_H
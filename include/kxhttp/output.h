@@ -0,0 +1,104 @@
+#ifndef KXHTTP_OUTPUT_H
+#define KXHTTP_OUTPUT_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "kxhttp/headers.h"
+
+// Output an OutputSink gathers before writing it to the stream in one go
+#ifndef KXHTTP_OUTPUT_BUFSIZ
+#define KXHTTP_OUTPUT_BUFSIZ size_t(64u * 1024u)
+#endif
+
+namespace KxHTTP
+{
+    // How results are printed, set with --format
+    enum OutputFormat
+    {
+        OUTPUT_TEXT, OUTPUT_JSON, OUTPUT_JSONL
+    };
+
+    // Where a request's time went, in microseconds. Connect and TLS stay 0
+    // when a kept-alive connection was reused.
+    struct ResponseTiming
+    {
+        uint64_t connect = 0; // Name resolution and TCP connect
+        uint64_t tls = 0;
+        uint64_t send = 0;    // Writing the request
+        uint64_t wait = 0;    // Request written to response head read
+        uint64_t receive = 0; // Reading the body
+        uint64_t total = 0;   // Every attempt, with the backoff between them
+    };
+
+    // One request's outcome, as --format json and jsonl print it. A request
+    // that got no response has an error and no status.
+    struct ResultRecord
+    {
+        std::string method;
+        std::string url;
+        int status = 0;
+        const HeaderList *headers = nullptr;
+        uint64_t bodyBytes = 0;
+        std::string outputFile;
+        unsigned attempts = 0;
+        ResponseTiming timing;
+        std::string error;
+    };
+
+    // Appends the record as one JSON object: indented for json, a single line for jsonl
+    void appendJsonRecord(std::string& out, const ResultRecord& record, OutputFormat format);
+    void appendJsonString(std::string& out, std::string_view s);
+
+    // Prints results produced by several threads from a single writer thread.
+    // submit() pushes onto a lock-free list and returns, so workers never wait
+    // on the stream or on each other. The writer batches whatever is queued
+    // into large writes, and flushes as soon as the queue runs dry.
+    class OutputSink
+    {
+        public:
+            // Ordered sinks print results by sequence, which must count up from 0
+            OutputSink(std::ostream& out, bool ordered);
+            ~OutputSink();
+            OutputSink(const OutputSink&) = delete;
+            OutputSink& operator=(const OutputSink&) = delete;
+
+            void submit(uint64_t sequence, std::string result);
+
+            // Writes out everything submitted so far and stops the writer
+            void close();
+
+        private:
+            struct Node
+            {
+                uint64_t sequence;
+                std::string result;
+                Node *next;
+            };
+
+            void writer();
+            void write(std::string& buffer, bool flush);
+
+            std::ostream& out;
+            bool ordered;
+            std::atomic<Node *> head;
+            std::atomic<bool> sleeping;
+            std::atomic<bool> closing;
+            std::mutex mutex; // Only to sleep on, submit() takes it just to wake the writer
+            std::condition_variable wake;
+            std::thread thread;
+
+            // Writer thread only
+            uint64_t nextSequence;
+            std::map<uint64_t, std::string> early;
+    };
+}
+
+#endif // KXHTTP_OUTPUT_H
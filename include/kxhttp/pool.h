@@ -0,0 +1,50 @@
+#ifndef KXHTTP_POOL_H
+#define KXHTTP_POOL_H
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "kxhttp/wire.h"
+
+// Idle connections kept per endpoint
+#ifndef KXHTTP_POOL_MAX_IDLE
+#define KXHTTP_POOL_MAX_IDLE 8
+#endif
+
+// Idle connections older than this are closed instead of reused
+#ifndef KXHTTP_POOL_IDLE_SECOND
+#define KXHTTP_POOL_IDLE_SECOND 60
+#endif
+
+namespace KxHTTP
+{
+    // Keep-alive connections shared between requests, grouped by endpoint.
+    // Safe to use from several threads.
+    class ConnectionPool
+    {
+        public:
+            // Hands out an idle connection when there is a live one, opens a new one otherwise
+            std::unique_ptr<Connection> acquire(const Endpoint& ep, bool& reused,
+                                                Connection::Deadline deadline = Connection::Deadline::max());
+            void release(std::unique_ptr<Connection> conn);
+
+            // Endpoints with the same key open the same kind of socket, so they can share one
+            static std::string keyOf(const Endpoint& ep);
+
+        private:
+            struct Idle
+            {
+                std::unique_ptr<Connection> conn;
+                std::chrono::steady_clock::time_point since;
+            };
+
+            std::mutex mutex;
+            std::map<std::string, std::vector<Idle>> idle;
+    };
+}
+
+#endif // KXHTTP_POOL_H
@@ -0,0 +1,48 @@
+#ifndef KXHTTP_RATELIMIT_H
+#define KXHTTP_RATELIMIT_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace KxHTTP
+{
+    // Caps the request rate per host with a token bucket each. Limits are
+    // set up before any request is sent and only read afterwards, so taking
+    // a token is a lookup plus a compare-and-swap, no lock.
+    class HostRateLimiter
+    {
+        public:
+            // "api.example.com=100" or "api.example.com=100:20", requests per second and burst
+            void addLimit(const std::string& spec);
+            bool empty() const;
+            void clear();
+
+            // The limits as addLimit() specs, rate and burst scaled by share,
+            // e.g. to split them between bench agents
+            std::vector<std::string> specs(double share = 1) const;
+
+            // Blocks until the host has a token, returns at once for hosts without a limit
+            void acquire(const std::string& host) const;
+
+        private:
+            // GCRA form of a token bucket: the bucket is the distance between
+            // now and the theoretical arrival time of the next request
+            struct Bucket
+            {
+                std::string host;
+                int64_t intervalNs;
+                int64_t toleranceNs; // (burst - 1) intervals may be taken early
+                mutable std::atomic<int64_t> arrivalNs{ 0 };
+            };
+
+            std::vector<std::unique_ptr<Bucket>> buckets;
+    };
+
+    // The process-wide limits from --max-rps
+    HostRateLimiter& hostRateLimiter();
+}
+
+#endif // KXHTTP_RATELIMIT_H
@@ -0,0 +1,63 @@
+#ifndef KXHTTP_RETRY_H
+#define KXHTTP_RETRY_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Retries allowed regardless of the budget, so a handful of requests can still retry
+#ifndef KXHTTP_RETRY_BUDGET_MIN
+#define KXHTTP_RETRY_BUDGET_MIN 10
+#endif
+
+// Longest Retry-After we are willing to sleep for
+#ifndef KXHTTP_RETRY_AFTER_MAX_SECOND
+#define KXHTTP_RETRY_AFTER_MAX_SECOND 120
+#endif
+
+namespace KxHTTP
+{
+    struct RetryOptions
+    {
+        unsigned retries = 0;              // attempts after the first one
+        std::vector<int> statuses{ 429, 503 };
+        double baseMs = 100;               // first backoff, doubled per attempt
+        double capMs = 10000;              // backoff ceiling
+        double budget = 0.2;               // retries as a share of all requests
+    };
+
+    // Exponential backoff with full jitter, Retry-After on the statuses that
+    // carry it, and a process-wide budget so an outage is not met with a
+    // multiple of the normal load. The budget is two counters, no lock.
+    class RetryPolicy
+    {
+        public:
+            void configure(const RetryOptions& options);
+            bool enabled() const;
+            unsigned maxRetries() const;
+            bool retryStatus(int status) const;
+
+            // Counts a first attempt towards the budget
+            void recordRequest();
+            // Takes a retry from the budget, false once it is spent
+            bool takeRetry();
+
+            // Milliseconds before attempt `retry` (1-based), Retry-After if the server sent one
+            double delayMs(unsigned retry, std::string_view retryAfter) const;
+
+        private:
+            RetryOptions options;
+            std::atomic<uint64_t> requests{ 0 };
+            std::atomic<uint64_t> retries{ 0 };
+    };
+
+    // "429,502-504" -> { 429, 502, 503, 504 }
+    std::vector<int> parseStatusList(const std::string& spec);
+
+    // The process-wide policy from --retries and friends
+    RetryPolicy& retryPolicy();
+}
+
+#endif // KXHTTP_RETRY_H
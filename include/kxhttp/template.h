@@ -0,0 +1,62 @@
+#ifndef KXHTTP_TEMPLATE_H
+#define KXHTTP_TEMPLATE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "kxhttp/wire.h"
+
+// Width a placeholder is reserved at, e.g. {{seq}} -> 000000000042
+#ifndef KXHTTP_PLACEHOLDER_WIDTH
+#define KXHTTP_PLACEHOLDER_WIDTH 12
+#endif
+
+namespace KxHTTP
+{
+    // Per-worker copy of the bytes a template patches
+    struct TemplateScratch
+    {
+        std::string head;
+        std::string body;
+    };
+
+    // Per-thread random numbers for {{rand}} and scenario picks, cheap rather than secure
+    uint64_t nextRandom();
+
+    // A request serialized once and replayed many times. Placeholders in the
+    // path, headers or body ({{seq}}, {{rand}}) are reserved at a fixed width,
+    // so per-request values are patched in place and Content-Length never moves.
+    class RequestTemplate
+    {
+        public:
+            RequestTemplate(const Endpoint& ep, const Request& req);
+
+            const Endpoint& getEndpoint() const;
+            bool isHeadRequest() const;
+            bool hasPlaceholders() const;
+
+            void write(Connection& conn, uint64_t sequence, TemplateScratch& scratch) const;
+
+        private:
+            enum PlaceholderKind { PLACEHOLDER_SEQ, PLACEHOLDER_RAND };
+
+            struct Placeholder
+            {
+                bool inBody;
+                size_t offset;
+                PlaceholderKind kind;
+            };
+
+            void reservePlaceholders(std::string& s, bool inBody);
+
+            Endpoint endpoint;
+            std::string head;
+            Body body;
+            bool headRequest;
+            bool bodyPlaceholders;
+            std::vector<Placeholder> placeholders;
+    };
+}
+
+#endif // KXHTTP_TEMPLATE_H
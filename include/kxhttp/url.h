@@ -0,0 +1,34 @@
+#ifndef KXHTTP_URL_H
+#define KXHTTP_URL_H
+
+#include <string>
+#include <string_view>
+
+namespace KxHTTP
+{
+    // Components of an absolute URL (RFC 3986), as views into the original
+    // string. Nothing is copied, so the URL must outlive the Url.
+    struct Url
+    {
+        std::string_view scheme;
+        std::string_view userinfo;
+        std::string_view host;      // IPv6 literals without their brackets
+        std::string_view port;
+        std::string_view path;
+        std::string_view query;     // Without the leading '?'
+        std::string_view fragment;  // Without the leading '#'
+        int portNumber = 0;         // Explicit port, 0 when absent
+        bool ipv6 = false;
+
+        bool isHttp() const;
+        bool isHttps() const;
+        int effectivePort() const;
+        std::string requestTarget() const; // Path and query, percent-encoded for the wire
+    };
+
+    // Single pass, allocation-free. Returns false for anything that is not
+    // an absolute URL with an authority.
+    bool parseUrl(std::string_view input, Url& url) noexcept;
+}
+
+#endif // KXHTTP_URL_H
@@ -0,0 +1,229 @@
+#ifndef KXHTTP_WIRE_H
+#define KXHTTP_WIRE_H
+
+#ifndef CPPHTTPLIB_OPENSSL_SUPPORT
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+#endif
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "httplib/httplib.h"
+#include "kxhttp/body.h"
+#include "kxhttp/headers.h"
+
+// Initial size of a connection's read buffer
+#ifndef KXHTTP_READ_BUFSIZ
+#define KXHTTP_READ_BUFSIZ size_t(4096u)
+#endif
+
+// Ceiling for a read buffer grown by --adaptive-read
+#ifndef KXHTTP_MAX_READ_BUFSIZ
+#define KXHTTP_MAX_READ_BUFSIZ size_t(1024u * 1024u)
+#endif
+
+// Consecutive reads that must fill the buffer before it is doubled
+#ifndef KXHTTP_ADAPTIVE_READ_STREAK
+#define KXHTTP_ADAPTIVE_READ_STREAK 4
+#endif
+
+// Largest response head we are willing to buffer
+#ifndef KXHTTP_MAX_HEAD_SIZE
+#define KXHTTP_MAX_HEAD_SIZE size_t(64u * 1024u)
+#endif
+
+// Cap on how much body memory we reserve up front from a Content-Length
+#ifndef KXHTTP_MAX_BODY_RESERVE
+#define KXHTTP_MAX_BODY_RESERVE uint64_t(64u * 1024u * 1024u)
+#endif
+
+// Files smaller than this are written from their mapping rather than with sendfile()
+#ifndef KXHTTP_SENDFILE_THRESHOLD
+#define KXHTTP_SENDFILE_THRESHOLD size_t(16u * 1024u)
+#endif
+
+// Pipe capacity asked for when splicing a download to disk
+#ifndef KXHTTP_SPLICE_PIPE_SIZE
+#define KXHTTP_SPLICE_PIPE_SIZE (1024 * 1024)
+#endif
+
+// How long an address that accepted a connection is reused without resolving again
+#ifndef KXHTTP_ADDRESS_CACHE_SECOND
+#define KXHTTP_ADDRESS_CACHE_SECOND 60
+#endif
+
+// Same defaults httplib's Client uses
+#ifndef KXHTTP_CONNECTION_TIMEOUT_SECOND
+#define KXHTTP_CONNECTION_TIMEOUT_SECOND 300
+#endif
+#ifndef KXHTTP_READ_TIMEOUT_SECOND
+#define KXHTTP_READ_TIMEOUT_SECOND 5
+#endif
+#ifndef KXHTTP_WRITE_TIMEOUT_SECOND
+#define KXHTTP_WRITE_TIMEOUT_SECOND 5
+#endif
+
+// The whole TLS handshake, enforced as one deadline rather than per read
+#ifndef KXHTTP_TLS_TIMEOUT_SECOND
+#define KXHTTP_TLS_TIMEOUT_SECOND 10
+#endif
+
+namespace KxHTTP
+{
+    // How a connection's socket and buffers are set up
+    struct ConnectionOptions
+    {
+        size_t readBufferSize = KXHTTP_READ_BUFSIZ;
+        bool adaptiveRead = false; // Grow the buffer and SO_RCVBUF on sustained full reads
+
+        // Socket tuning, applied where the platform supports it
+        bool tcpNoDelay = true;
+        bool tcpFastOpen = false;
+        bool quickAck = false;
+        int busyPoll = 0;   // microseconds, 0 leaves the system default
+        int sendBuffer = 0; // SO_SNDBUF, 0 leaves the system default
+        int recvBuffer = 0; // SO_RCVBUF, 0 leaves the system default
+
+        // Milliseconds. The deadline bounds a whole request, connect to last byte, 0 for none.
+        int connectTimeoutMs = KXHTTP_CONNECTION_TIMEOUT_SECOND * 1000;
+        int readTimeoutMs = KXHTTP_READ_TIMEOUT_SECOND * 1000;
+        int writeTimeoutMs = KXHTTP_WRITE_TIMEOUT_SECOND * 1000;
+        int tlsTimeoutMs = KXHTTP_TLS_TIMEOUT_SECOND * 1000;
+        int deadlineMs = 0;
+    };
+
+    // Where a connection goes, and how. IPv6 hosts are kept without their brackets.
+    struct Endpoint
+    {
+        std::string host;
+        int port = 80;
+        bool tls = false;
+        std::string unixSocket; // Connect here instead of host:port, Host still comes from the URL
+        ConnectionOptions options;
+
+        std::string hostHeader() const;
+    };
+
+    // Time spent opening a connection, in microseconds. Connect includes name resolution.
+    struct OpenTiming
+    {
+        uint64_t connect = 0;
+        uint64_t tls = 0;
+    };
+
+    // A single HTTP/1.1 connection, plain or TLS. Requests are written as
+    // scatter/gather buffers and responses are read through an internal buffer.
+    class Connection
+    {
+        public:
+            using Deadline = std::chrono::steady_clock::time_point;
+
+            explicit Connection(const Endpoint& ep, Deadline deadline = Deadline::max());
+            ~Connection();
+            Connection(const Connection&) = delete;
+            Connection& operator=(const Connection&) = delete;
+
+            void reconnect();
+            void close();
+            bool isOpen() const;
+            bool isReusable() const;
+            const Endpoint& getEndpoint() const;
+
+            // Caps every later connect, read and write, on top of their own timeouts
+            void setDeadline(Deadline deadline);
+
+            // How long the last open took, once: later requests on the connection get zeros
+            OpenTiming takeOpenTiming();
+
+            // The peer closed or reset the connection under a read or write, as
+            // opposed to a timeout, where it may still be working on the request
+            bool peerDropped() const;
+            uint64_t bytesReceived() const;
+
+            void write(const struct iovec *iov, int count, bool more = false);
+            void write(std::string_view data);
+            void write(std::string_view head, const Body& body);
+            void sendFile(const MappedFile& file);
+            bool canSendFile() const;
+            bool kernelTlsSend() const;
+            ssize_t readSome(char *buf, size_t size);
+
+            // Moves exactly length body bytes into a file, buffered bytes first
+            bool canSplice() const;
+            void spliceTo(int fd, uint64_t length);
+
+            // Index of the first connection with response bytes to read, -1 on timeout.
+            // The wait ends at the earliest deadline, which throws like any other wait.
+            static int waitReadable(Connection *const *conns, size_t count, int timeoutMs);
+
+            // Buffered reads used by the response parser
+            bool fill();
+            std::string_view buffered() const;
+            void consume(size_t n);
+
+        private:
+            void open();
+            void adaptReadBuffer(bool fullRead);
+            void growReceiveBuffer(int size);
+            void quickAck();
+            int budgetMs(int timeoutMs) const;
+            void armTimeout(int name, int timeoutMs);
+            void armDeadline(int name);
+            bool waitWritable();
+
+            Endpoint endpoint;
+            Deadline deadline;
+            OpenTiming opened;
+            bool dropped;
+            uint64_t received;
+            socket_t sock;
+            SSL *ssl;
+            std::vector<char> readBuffer;
+            size_t readPos;
+            size_t readEnd;
+            unsigned fullReads;
+            std::vector<struct iovec> pendingIov;
+            std::string sessionKey;
+    };
+
+    // An outgoing request, fully built and ready to be serialized
+    struct Request
+    {
+        std::string method;
+        std::string path;
+        HeaderList headers;
+        Body body;
+
+        // httplib always announces a length for POST, PUT and PATCH
+        bool sendsContentLength() const
+        {
+            return !this->body.empty() || this->method == "POST" || this->method == "PUT" || this->method == "PATCH";
+        }
+    };
+
+    struct Response
+    {
+        int status = 0;
+        HeaderList headers;
+        std::string body;
+        bool keepAlive = false;
+    };
+
+    using BodySink = std::function<bool(const char *data, size_t size)>;
+
+    void serializeRequestHead(std::string& out, std::string_view method, std::string_view path,
+                              const Endpoint& endpoint, const HeaderList& headers,
+                              size_t contentLength, bool sendContentLength);
+    void readResponseHead(Connection& conn, Response& res);
+    void readResponseBody(Connection& conn, bool headRequest, Response& res, const BodySink& sink);
+    void readResponseBody(Connection& conn, bool headRequest, Response& res);
+    void readResponse(Connection& conn, bool headRequest, Response& res);
+
+    // Streams the body straight to a file instead of keeping it in memory, returns its size
+    uint64_t saveResponseBody(Connection& conn, Response& res, const std::string& path);
+}
+
+#endif // KXHTTP_WIRE_H
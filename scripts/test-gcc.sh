@@ -0,0 +1,17 @@
+#!/bin/bash
+
+# This script is set to run using the root project directory.
+# It builds the wire layer tests against the sources they cover and runs them.
+
+echo "Building KxHTTP tests"
+
+mkdir -p bin
+g++ -O2 tests/wire_test.cpp src/wire.cpp src/headers.cpp src/body.cpp -Iinclude -I/usr/local/include -o bin/wire_test -L/usr/local/lib -lssl -lcrypto -lpthread
+
+# Check if the build was successful
+if [ $? -ne 0 ]; then
+    echo "Build failed"
+    exit 1
+fi
+
+./bin/wire_test
@@ -0,0 +1,338 @@
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <openssl/crypto.h>
+
+#include "kxhttp.h"
+
+namespace
+{
+    // "host:port", "[v6]:port", "host" or ":port"
+    void splitHostPort(const std::string& spec, std::string& host, std::string& port)
+    {
+        port = std::to_string(KXHTTP_AGENT_PORT);
+        if (!spec.empty() && spec[0] == '[') {
+            auto close = spec.find(']');
+            if (close == std::string::npos)
+                throw std::runtime_error("Invalid agent address: " + spec);
+            host = spec.substr(1, close - 1);
+            if (close + 1 < spec.size() && spec[close + 1] == ':')
+                port = spec.substr(close + 2);
+            return;
+        }
+
+        auto colon = spec.rfind(':');
+        if (colon == std::string::npos || spec.find(':') != colon) {
+            host = spec;
+            return;
+        }
+        host = spec.substr(0, colon);
+        port = spec.substr(colon + 1);
+    }
+
+    bool sameToken(const std::string& a, const std::string& b)
+    {
+        return a.size() == b.size() && CRYPTO_memcmp(a.data(), b.data(), a.size()) == 0;
+    }
+
+    void encodeOptions(std::string& out, const KxHTTP::BenchOptions& options)
+    {
+        KxHTTP::putU64(out, options.requests);
+        KxHTTP::putU32(out, options.concurrency);
+        KxHTTP::putU32(out, options.rampFromZero ? 1u : 0u);
+        KxHTTP::putU32(out, static_cast<uint32_t>(options.stages.size()));
+        for (const auto& stage : options.stages) {
+            KxHTTP::putDouble(out, stage.rate);
+            KxHTTP::putDouble(out, stage.seconds);
+        }
+    }
+
+    KxHTTP::BenchOptions decodeOptions(KxHTTP::FrameReader& in)
+    {
+        KxHTTP::BenchOptions options;
+        options.requests = in.u64();
+        options.concurrency = in.u32();
+        options.rampFromZero = in.u32() != 0;
+        for (uint32_t i = in.u32(); i > 0; i--) {
+            KxHTTP::BenchStage stage;
+            stage.rate = in.f64();
+            stage.seconds = in.f64();
+            options.stages.push_back(stage);
+        }
+        return options;
+    }
+
+    // The share of the run agent `index` of `count` takes on
+    KxHTTP::BenchOptions shareOf(const KxHTTP::BenchOptions& options, size_t index, size_t count)
+    {
+        KxHTTP::BenchOptions share = options;
+        share.requests = options.requests / count + (index < options.requests % count ? 1 : 0);
+        for (auto& stage : share.stages)
+            stage.rate /= static_cast<double>(count);
+        return share;
+    }
+
+    std::vector<KxHTTP::BenchScenario> jobScenarios(const KxHTTP::RequestData& request, const std::string& scenarioText)
+    {
+        if (!scenarioText.empty()) {
+            std::istringstream input(scenarioText);
+            return KxHTTP::parseScenarios(input, "scenario", request);
+        }
+        KxHTTP::HTTPRequest rq{ KxHTTP::RequestData(request) };
+        return { { std::string(), rq.compile() } };
+    }
+
+#ifndef _WIN32
+    void setReceiveTimeout(int fd, int seconds)
+    {
+        struct timeval tv {};
+        tv.tv_sec = seconds;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    }
+
+    int connectAgent(const std::string& spec)
+    {
+        std::string host, port;
+        splitHostPort(spec, host, port);
+
+        struct addrinfo hints {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        struct addrinfo *result = nullptr;
+        if (getaddrinfo(host.empty() ? "localhost" : host.c_str(), port.c_str(), &hints, &result) != 0)
+            throw std::runtime_error("Failed to resolve agent " + spec);
+
+        int fd = -1;
+        for (auto *ai = result; ai != nullptr && fd == -1; ai = ai->ai_next) {
+            fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+            if (fd != -1 && connect(fd, ai->ai_addr, ai->ai_addrlen) == -1) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(result);
+        if (fd == -1)
+            throw std::runtime_error("Failed to connect to agent " + spec);
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        return fd;
+    }
+
+    // Reads an agent's reply, throwing with its message unless it is REPLY_OK
+    void expectOk(const std::string& agent, const std::string& reply)
+    {
+        KxHTTP::FrameReader in{ reply };
+        uint32_t status = in.u32();
+        if (status == KxHTTP::REPLY_INCOMPATIBLE)
+            throw std::runtime_error("Agent " + agent + " runs an incompatible kxh version");
+        if (status != KxHTTP::REPLY_OK)
+            throw std::runtime_error("Agent " + agent + ": " + in.string());
+    }
+#endif
+}
+
+//
+// BenchAgent Class Implementations
+//
+
+KxHTTP::BenchAgent::BenchAgent(const std::string& address, const std::string& token)
+{
+    this->address = address;
+    this->token = token;
+    this->listener = -1;
+}
+
+KxHTTP::BenchAgent::~BenchAgent()
+{
+#ifndef _WIN32
+    if (this->listener != -1)
+        ::close(this->listener);
+#endif
+}
+
+void KxHTTP::BenchAgent::run()
+{
+#ifdef _WIN32
+    throw std::runtime_error("Agent mode is not supported on this platform");
+#else
+    // The agent sends requests for whoever connects, so it never runs without a secret
+    if (this->token.empty())
+        throw std::runtime_error("kxh agent needs a --token (or $KXH_AGENT_TOKEN)");
+
+    std::string host, port;
+    splitHostPort(this->address, host, port);
+
+    struct addrinfo hints {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    struct addrinfo *result = nullptr;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result) != 0 || result == nullptr)
+        throw std::runtime_error("Invalid agent listen address: " + this->address);
+
+    this->listener = socket(result->ai_family, result->ai_socktype | SOCK_CLOEXEC, result->ai_protocol);
+    int one = 1;
+    if (this->listener != -1)
+        setsockopt(this->listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    bool listening = this->listener != -1 && bind(this->listener, result->ai_addr, result->ai_addrlen) == 0
+                     && listen(this->listener, SOMAXCONN) == 0;
+    freeaddrinfo(result);
+    if (!listening)
+        throw std::runtime_error("Failed to listen on " + this->address);
+
+    std::cout << KXHTTP_CONSOLE_GREEN << "kxh agent listening on " << this->address << KXHTTP_CONSOLE_RESET << std::endl;
+
+    // One job at a time, two runs sharing the machine would skew each other
+    while (true) {
+        int client = httplib::detail::handle_EINTR([&]() { return accept4(this->listener, nullptr, nullptr, SOCK_CLOEXEC); });
+        if (client == -1)
+            continue;
+        this->serve(client);
+        ::close(client);
+    }
+#endif
+}
+
+void KxHTTP::BenchAgent::serve(int client)
+{
+#ifndef _WIN32
+    setReceiveTimeout(client, KXHTTP_AGENT_HANDSHAKE_SECOND);
+
+    std::string frame;
+    if (!receiveFrame(client, frame, KXHTTP_AGENT_MAX_FRAME))
+        return;
+
+    std::string reply;
+    std::unique_ptr<Bench> runner;
+    try {
+        FrameReader in{ frame };
+        if (in.u32() != KXHTTP_AGENT_PROTOCOL) {
+            putU32(reply, REPLY_INCOMPATIBLE);
+            sendFrame(client, reply);
+            return;
+        }
+        if (!sameToken(in.string(), this->token))
+            throw std::runtime_error("Invalid agent token");
+
+        RequestData request = decodeRequestData(in);
+        std::string scenarioText = in.string();
+        BenchOptions options = decodeOptions(in);
+
+        // This agent's share of the coordinator's --max-rps, nothing is in flight between jobs
+        hostRateLimiter().clear();
+        for (const auto& limit : in.strings())
+            hostRateLimiter().addLimit(limit);
+        runner = std::make_unique<Bench>(jobScenarios(request, scenarioText), options);
+        putU32(reply, REPLY_OK);
+    } catch (const std::exception& e) {
+        reply.clear();
+        putU32(reply, REPLY_ERROR);
+        putString(reply, e.what());
+        sendFrame(client, reply);
+        return;
+    }
+
+    // Ready, the run starts once every agent is
+    std::string start;
+    if (!sendFrame(client, reply) || !receiveFrame(client, start, KXHTTP_AGENT_MAX_FRAME))
+        return;
+
+    std::cout << "Running a job for the coordinator..." << std::endl;
+    runner->run();
+
+    reply.clear();
+    putU32(reply, REPLY_OK);
+    runner->encodeResults(reply);
+    sendFrame(client, reply);
+    std::cout << "Finished in " << runner->elapsed() << "s" << std::endl;
+#else
+    (void)client;
+#endif
+}
+
+void KxHTTP::runOnAgents(const std::vector<std::string>& agents, const std::string& token,
+                         const KxHTTP::RequestData& request, const std::string& scenarioText,
+                         const KxHTTP::BenchOptions& options)
+{
+#ifdef _WIN32
+    (void)agents;
+    (void)token;
+    (void)request;
+    (void)scenarioText;
+    (void)options;
+    throw std::runtime_error("Distributed benchmarks are not supported on this platform");
+#else
+    // Compiled here as well, it catches bad input early and names the report's scenarios
+    Bench report(jobScenarios(request, scenarioText), options);
+
+    // Scenario lines bring their own methods, the defaults still need a valid one on the wire
+    RequestData defaults = request;
+    if (!scenarioText.empty())
+        defaults.method = HTTP_GET;
+
+    std::vector<int> sockets;
+    auto closeAll = [&]() {
+        for (int fd : sockets)
+            ::close(fd);
+    };
+
+    try {
+        for (size_t i = 0; i < agents.size(); i++) {
+            sockets.push_back(connectAgent(agents[i]));
+            setReceiveTimeout(sockets.back(), KXHTTP_AGENT_HANDSHAKE_SECOND);
+
+            std::string job;
+            putU32(job, KXHTTP_AGENT_PROTOCOL);
+            putString(job, token);
+            encodeRequestData(job, defaults);
+            putString(job, scenarioText);
+            encodeOptions(job, shareOf(options, i, agents.size()));
+            putStrings(job, hostRateLimiter().specs(1.0 / static_cast<double>(agents.size())));
+            if (!sendFrame(sockets.back(), job))
+                throw std::runtime_error("Failed to send the job to agent " + agents[i]);
+        }
+
+        std::string reply;
+        for (size_t i = 0; i < agents.size(); i++) {
+            if (!receiveFrame(sockets[i], reply, KXHTTP_AGENT_MAX_FRAME))
+                throw std::runtime_error("Agent " + agents[i] + " did not answer");
+            expectOk(agents[i], reply);
+        }
+
+        std::cout << KXHTTP_CONSOLE_YELLOW << "Starting " << agents.size() << " agents" << KXHTTP_CONSOLE_RESET << std::endl;
+        std::string start;
+        putU32(start, REPLY_OK);
+        for (size_t i = 0; i < agents.size(); i++) {
+            setReceiveTimeout(sockets[i], 0);
+            if (!sendFrame(sockets[i], start))
+                throw std::runtime_error("Failed to start agent " + agents[i]);
+        }
+
+        for (size_t i = 0; i < agents.size(); i++) {
+            if (!receiveFrame(sockets[i], reply, KXHTTP_AGENT_MAX_FRAME))
+                throw std::runtime_error("Lost the connection to agent " + agents[i]);
+            expectOk(agents[i], reply);
+            FrameReader in{ reply };
+            in.u32();
+            report.addResults(in);
+        }
+    } catch (...) {
+        closeAll();
+        throw;
+    }
+    closeAll();
+
+    report.printReport();
+#endif
+}
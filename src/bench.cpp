@@ -0,0 +1,592 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+#include "kxhttp.h"
+
+namespace
+{
+    bool sameEndpoint(const KxHTTP::Endpoint& a, const KxHTTP::Endpoint& b)
+    {
+        // Socket options count too, a connection keeps the tuning it was opened with
+        return KxHTTP::ConnectionPool::keyOf(a) == KxHTTP::ConnectionPool::keyOf(b);
+    }
+
+    void printLatencyLine(const KxHTTP::LatencyHistogram& h)
+    {
+        std::cout << "min: " << h.min() / 1000.0 << "  avg: " << h.mean() / 1000.0
+                  << "  p50: " << h.percentile(0.5) / 1000.0 << "  p90: " << h.percentile(0.9) / 1000.0
+                  << "  p99: " << h.percentile(0.99) / 1000.0 << "  max: " << h.max() / 1000.0 << "\n";
+    }
+
+    void printDistribution(const KxHTTP::LatencyHistogram& h)
+    {
+        static const double bounds[] = { 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000 };
+        const size_t slots = sizeof(bounds) / sizeof(bounds[0]) + 1;
+        std::vector<uint64_t> counts(slots, 0);
+        h.forEach([&](uint32_t micros, uint64_t count) {
+            size_t slot = 0;
+            while (slot < slots - 1 && micros / 1000.0 > bounds[slot])
+                slot++;
+            counts[slot] += count;
+        });
+
+        size_t first = 0, last = slots - 1;
+        while (first < last && counts[first] == 0)
+            first++;
+        while (last > first && counts[last] == 0)
+            last--;
+        uint64_t peak = std::max<uint64_t>(1, *std::max_element(counts.begin(), counts.end()));
+
+        for (size_t slot = first; slot <= last; slot++) {
+            std::ostringstream label;
+            if (slot < slots - 1)
+                label << "<= " << bounds[slot];
+            else
+                label << " > " << bounds[slots - 2];
+            std::cout << std::setw(9) << label.str() << "  " << std::setw(9) << counts[slot] << "  "
+                      << std::string(static_cast<size_t>(40 * counts[slot] / peak), '#') << "\n";
+        }
+    }
+}
+
+std::vector<KxHTTP::BenchStage> KxHTTP::parseStages(const std::string& spec)
+{
+    std::vector<BenchStage> stages;
+    std::stringstream list(spec);
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        auto colon = item.find(':');
+        if (colon == std::string::npos)
+            throw std::runtime_error("Invalid stage '" + item + "', expected RATE:DURATION such as 500:30s");
+
+        BenchStage stage;
+        std::string duration = item.substr(colon + 1);
+        try {
+            stage.rate = std::stod(item.substr(0, colon));
+        } catch (const std::exception&) {
+            throw std::runtime_error("Invalid rate in stage '" + item + "'");
+        }
+        if (!durationTransformer()(duration).empty() || !CLI::detail::lexical_cast(duration, stage.seconds))
+            throw std::runtime_error("Invalid duration in stage '" + item + "'");
+        stage.seconds /= 1000.0;
+
+        if (stage.rate < 0 || stage.seconds < 0)
+            throw std::runtime_error("Stages need a non-negative rate and duration: '" + item + "'");
+        stages.push_back(stage);
+    }
+    return stages;
+}
+
+KxHTTP::BenchSlo KxHTTP::parseSlo(const std::string& spec)
+{
+    auto op = spec.find('<');
+    if (spec.size() < 2 || spec[0] != 'p' || op == std::string::npos)
+        throw std::runtime_error("Invalid SLO '" + spec + "', expected e.g. p99<50ms");
+
+    BenchSlo slo;
+    double percent = 0;
+    std::string limit = spec.substr(spec[op + 1] == '=' ? op + 2 : op + 1);
+    if (!CLI::detail::lexical_cast(spec.substr(1, op - 1), percent) || percent <= 0 || percent > 100)
+        throw std::runtime_error("Invalid percentile in SLO '" + spec + "'");
+    if (!durationTransformer()(limit).empty() || !CLI::detail::lexical_cast(limit, slo.limitMs) || slo.limitMs <= 0)
+        throw std::runtime_error("Invalid latency in SLO '" + spec + "'");
+
+    slo.quantile = percent / 100;
+    return slo;
+}
+
+std::vector<KxHTTP::BenchScenario> KxHTTP::loadScenarios(const std::string& path, const KxHTTP::RequestData& defaults)
+{
+    std::ifstream file(path);
+    if (!file)
+        throw std::runtime_error("Failed to open scenario file: " + path);
+    return parseScenarios(file, path, defaults);
+}
+
+std::vector<KxHTTP::BenchScenario> KxHTTP::parseScenarios(std::istream& input, const std::string& source,
+                                                          const KxHTTP::RequestData& defaults)
+{
+    std::vector<BenchScenario> scenarios;
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(input, line)) {
+        lineNumber++;
+        auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+
+        // Each line is parsed like a kxh command line, on top of the bench's
+        // connection settings, headers and cookies
+        RequestData rd = defaults;
+        rd.headers.clear();
+        rd.cookies.clear();
+        rd.formData.clear();
+        rd.formFiles.clear();
+        rd.jsonData.clear();
+        rd.jsonFile.clear();
+        rd.dataBinary.clear();
+
+        std::string methodStr;
+        std::string name;
+        unsigned weight = 1;
+        double thinkMs = 0;
+        unsigned concurrency = 0;
+
+        CLI::App app("scenario");
+        app.set_help_flag();
+        addRequestTarget(&app, rd, methodStr);
+        addRequestOptions(&app, rd);
+        app.add_option("--name", name, "Name shown in the report");
+        app.add_option("--weight", weight, "Relative share of requests")->check(CLI::PositiveNumber);
+        app.add_option("--think", thinkMs, "Pause after each request")
+                ->transform(durationTransformer())
+                ->check(CLI::NonNegativeNumber);
+        app.add_option("--concurrency", concurrency, "Dedicated workers for this scenario");
+
+        try {
+            app.parse(line.substr(first), false);
+            if (methodStr.empty() || rd.url.empty())
+                throw std::runtime_error("expected a method and a URL");
+        } catch (const std::exception& e) {
+            throw std::runtime_error(source + ":" + std::to_string(lineNumber) + ": " + e.what());
+        }
+
+        rd.headers.insert(rd.headers.begin(), defaults.headers.begin(), defaults.headers.end());
+        rd.cookies.insert(rd.cookies.begin(), defaults.cookies.begin(), defaults.cookies.end());
+        rd.method = stringToMethod(methodStr);
+        if (name.empty())
+            name = methodStr + " " + rd.url;
+
+        HTTPRequest rq(std::move(rd));
+        scenarios.push_back({ name, rq.compile(), weight, thinkMs, concurrency });
+    }
+
+    if (scenarios.empty())
+        throw std::runtime_error("Scenario file has no requests: " + source);
+    return scenarios;
+}
+
+//
+// Bench Class Implementations
+//
+
+KxHTTP::Bench::Bench(const KxHTTP::RequestTemplate& tpl, const KxHTTP::BenchOptions& options)
+    : Bench(std::vector<BenchScenario>{ { std::string(), tpl } }, options)
+{
+}
+
+KxHTTP::Bench::Bench(std::vector<KxHTTP::BenchScenario> scenarios, const KxHTTP::BenchOptions& options)
+    : scenarios(std::move(scenarios)), options(options), issued(0), elapsedSeconds(0), agents(0)
+{
+    // A staged run sends exactly what its rate curve integrates to
+    if (!this->options.stages.empty()) {
+        double from = this->options.rampFromZero ? 0 : this->options.stages.front().rate;
+        double count = 0;
+        double time = 0;
+        for (const auto& stage : this->options.stages) {
+            this->stageFrom.push_back(from);
+            this->stageCount.push_back(count);
+            this->stageTime.push_back(time);
+            count += (from + stage.rate) / 2 * stage.seconds;
+            time += stage.seconds;
+            from = stage.rate;
+        }
+        this->stageCount.push_back(count);
+        this->options.requests = static_cast<uint64_t>(count);
+    }
+
+    for (size_t i = 0; i < this->scenarios.size(); i++) {
+        size_t slot = i;
+        for (size_t j = 0; j < i; j++) {
+            if (sameEndpoint(this->scenarios[i].requestTemplate.getEndpoint(), this->scenarios[j].requestTemplate.getEndpoint())) {
+                slot = this->endpointSlots[j];
+                break;
+            }
+        }
+        this->endpointSlots.push_back(slot);
+    }
+
+    // The shared group picks among weighted scenarios, dedicated groups run one each
+    WorkerGroup shared;
+    uint64_t weights = 0;
+    for (size_t i = 0; i < this->scenarios.size(); i++) {
+        const auto& scenario = this->scenarios[i];
+        if (scenario.concurrency > 0) {
+            this->groups.push_back({ { i }, { 1 } });
+            this->workerGroups.insert(this->workerGroups.end(), scenario.concurrency, this->groups.size() - 1);
+        } else {
+            weights += scenario.weight;
+            shared.scenarios.push_back(i);
+            shared.cumulativeWeights.push_back(weights);
+        }
+    }
+
+    if (!shared.scenarios.empty()) {
+        unsigned concurrency = std::max(this->options.concurrency, 1u);
+        concurrency = static_cast<unsigned>(std::min<uint64_t>(concurrency, std::max<uint64_t>(this->options.requests, 1)));
+        this->groups.push_back(std::move(shared));
+        this->workerGroups.insert(this->workerGroups.end(), concurrency, this->groups.size() - 1);
+    }
+    this->options.concurrency = static_cast<unsigned>(this->workerGroups.size());
+}
+
+KxHTTP::LatencyHistogram KxHTTP::Bench::latency() const
+{
+    LatencyHistogram latencies;
+    for (const auto& stats : this->workerStats)
+        for (const auto& h : stats.latencies)
+            latencies.merge(h);
+    return latencies;
+}
+
+uint64_t KxHTTP::Bench::failures() const
+{
+    uint64_t errors = 0;
+    for (const auto& stats : this->workerStats)
+        errors += stats.errors;
+    return errors;
+}
+
+double KxHTTP::Bench::elapsed() const
+{
+    return this->elapsedSeconds;
+}
+
+void KxHTTP::Bench::encodeResults(std::string& out) const
+{
+    std::vector<LatencyHistogram> perScenario(this->scenarios.size());
+    std::vector<LatencyHistogram> perStage(this->options.stages.size());
+    std::vector<uint64_t> stageErrors(this->options.stages.size(), 0);
+    std::map<int, uint64_t> statusCounts;
+    uint64_t errors = 0;
+    uint64_t bodyBytes = 0;
+
+    for (const auto& stats : this->workerStats) {
+        for (size_t i = 0; i < perScenario.size(); i++)
+            perScenario[i].merge(stats.latencies[i]);
+        for (size_t i = 0; i < perStage.size(); i++) {
+            perStage[i].merge(stats.stageLatencies[i]);
+            stageErrors[i] += stats.stageErrors[i];
+        }
+        for (const auto& entry : stats.statusCounts)
+            statusCounts[entry.first] += entry.second;
+        errors += stats.errors;
+        bodyBytes += stats.bodyBytes;
+    }
+
+    putDouble(out, this->elapsedSeconds);
+    putU64(out, errors);
+    putU64(out, bodyBytes);
+    putU32(out, static_cast<uint32_t>(statusCounts.size()));
+    for (const auto& entry : statusCounts) {
+        putU32(out, static_cast<uint32_t>(entry.first));
+        putU64(out, entry.second);
+    }
+    putU32(out, static_cast<uint32_t>(perScenario.size()));
+    for (const auto& h : perScenario)
+        h.serialize(out);
+    putU32(out, static_cast<uint32_t>(perStage.size()));
+    for (size_t i = 0; i < perStage.size(); i++) {
+        perStage[i].serialize(out);
+        putU64(out, stageErrors[i]);
+    }
+}
+
+void KxHTTP::Bench::addResults(KxHTTP::FrameReader& in)
+{
+    // Kept as one more worker's stats, so the report merges it like a local one
+    WorkerStats stats;
+    double elapsed = in.f64();
+    stats.errors = in.u64();
+    stats.bodyBytes = in.u64();
+    for (uint32_t i = in.u32(); i > 0; i--) {
+        int status = static_cast<int>(in.u32());
+        stats.statusCounts[status] += in.u64();
+    }
+
+    if (in.u32() != this->scenarios.size())
+        throw std::runtime_error("Agent results do not match the scenarios");
+    stats.latencies.resize(this->scenarios.size());
+    for (auto& h : stats.latencies)
+        h.deserialize(in);
+
+    if (in.u32() != this->options.stages.size())
+        throw std::runtime_error("Agent results do not match the stages");
+    stats.stageLatencies.resize(this->options.stages.size());
+    stats.stageErrors.resize(this->options.stages.size());
+    for (size_t i = 0; i < this->options.stages.size(); i++) {
+        stats.stageLatencies[i].deserialize(in);
+        stats.stageErrors[i] = in.u64();
+    }
+
+    this->workerStats.push_back(std::move(stats));
+    this->elapsedSeconds = std::max(this->elapsedSeconds, elapsed);
+    this->agents++;
+}
+
+double KxHTTP::Bench::scheduledAt(uint64_t sequence, size_t& stage) const
+{
+    // Request n goes out when the integral of the rate reaches n + 1
+    double n = static_cast<double>(sequence) + 1;
+    stage = 0;
+    while (stage + 1 < this->options.stages.size() && this->stageCount[stage + 1] < n)
+        stage++;
+
+    double r0 = this->stageFrom[stage];
+    double r1 = this->options.stages[stage].rate;
+    double d = this->options.stages[stage].seconds;
+    double left = n - this->stageCount[stage];
+
+    // left = r0 t + (r1 - r0) / (2 d) t^2, solved for t
+    double t;
+    double a = d > 0 ? (r1 - r0) / (2 * d) : 0;
+    if (std::abs(a) < 1e-12)
+        t = r0 > 0 ? left / r0 : 0;
+    else
+        t = (-r0 + std::sqrt(std::max(0.0, r0 * r0 + 4 * a * left))) / (2 * a);
+    return this->stageTime[stage] + std::min(std::max(t, 0.0), d);
+}
+
+void KxHTTP::Bench::run()
+{
+    this->workerStats.assign(this->workerGroups.size(), WorkerStats());
+    this->issued = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    this->startTime = start;
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < this->workerGroups.size(); i++)
+        workers.emplace_back(&Bench::worker, this, std::cref(this->groups[this->workerGroups[i]]), std::ref(this->workerStats[i]));
+    for (auto& t : workers)
+        t.join();
+
+    this->elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void KxHTTP::Bench::worker(const WorkerGroup& group, WorkerStats& stats)
+{
+    // One connection per distinct endpoint and one scratch per scenario
+    std::vector<std::unique_ptr<Connection>> connections(this->scenarios.size());
+    std::vector<TemplateScratch> scratch(this->scenarios.size());
+    Response res;
+    stats.latencies.assign(this->scenarios.size(), LatencyHistogram());
+    stats.stageLatencies.assign(this->options.stages.size(), LatencyHistogram());
+    stats.stageErrors.assign(this->options.stages.size(), 0);
+
+    // Bodies are counted and dropped, nothing is buffered per request
+    BodySink discard = [&stats](const char *, size_t size) {
+        stats.bodyBytes += size;
+        return true;
+    };
+
+    uint64_t sequence;
+    while ((sequence = this->issued.fetch_add(1, std::memory_order_relaxed)) < this->options.requests) {
+        size_t pick = 0;
+        if (group.scenarios.size() > 1) {
+            uint64_t ticket = nextRandom() % group.cumulativeWeights.back();
+            pick = static_cast<size_t>(std::upper_bound(group.cumulativeWeights.begin(), group.cumulativeWeights.end(), ticket)
+                                       - group.cumulativeWeights.begin());
+        }
+        size_t index = group.scenarios[pick];
+        const BenchScenario& scenario = this->scenarios[index];
+        auto& conn = connections[this->endpointSlots[index]];
+
+        // A --max-rps wait is the client holding back, not server latency
+        hostRateLimiter().acquire(scenario.requestTemplate.getEndpoint().host);
+        auto start = std::chrono::steady_clock::now();
+
+        // Open-loop: wait for the request's slot on the rate curve, and measure
+        // from that slot so time spent queued behind a slow server is counted too
+        size_t stage = 0;
+        if (!this->options.stages.empty()) {
+            auto due = this->startTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(this->scheduledAt(sequence, stage)));
+            if (due > start)
+                std::this_thread::sleep_until(due);
+            start = due;
+        }
+
+        // --max-time counts from the same point the latency does
+        int deadlineMs = scenario.requestTemplate.getEndpoint().options.deadlineMs;
+        Connection::Deadline deadline = deadlineMs > 0 ? start + std::chrono::milliseconds(deadlineMs)
+                                                       : Connection::Deadline::max();
+
+        try {
+            if (!conn) {
+                conn = std::make_unique<Connection>(scenario.requestTemplate.getEndpoint(), deadline);
+            } else {
+                conn->setDeadline(deadline);
+                if (!conn->isOpen())
+                    conn->reconnect();
+            }
+
+            scenario.requestTemplate.write(*conn, sequence, scratch[index]);
+            readResponseHead(*conn, res);
+            readResponseBody(*conn, scenario.requestTemplate.isHeadRequest(), res, discard);
+
+            if (!res.keepAlive)
+                conn->close();
+
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+            uint32_t micros = static_cast<uint32_t>(std::min<int64_t>(elapsed.count(), UINT32_MAX));
+            stats.latencies[index].record(micros);
+            if (!stats.stageLatencies.empty())
+                stats.stageLatencies[stage].record(micros);
+            stats.statusCounts[res.status]++;
+        } catch (const std::exception&) {
+            stats.errors++;
+            if (!stats.stageErrors.empty())
+                stats.stageErrors[stage]++;
+            conn.reset();
+        }
+
+        if (scenario.thinkMs > 0)
+            std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(scenario.thinkMs));
+    }
+}
+
+void KxHTTP::Bench::printReport() const
+{
+    LatencyHistogram latencies;
+    std::vector<LatencyHistogram> perScenario(this->scenarios.size());
+    std::map<int, uint64_t> statusCounts;
+    uint64_t errors = 0;
+    uint64_t bodyBytes = 0;
+
+    for (const auto& stats : this->workerStats) {
+        for (size_t i = 0; i < stats.latencies.size(); i++) {
+            latencies.merge(stats.latencies[i]);
+            perScenario[i].merge(stats.latencies[i]);
+        }
+        for (const auto& entry : stats.statusCounts)
+            statusCounts[entry.first] += entry.second;
+        errors += stats.errors;
+        bodyBytes += stats.bodyBytes;
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << KXHTTP_CONSOLE_YELLOW << "Benchmarked " << this->options.requests << " requests over "
+              << this->options.concurrency * std::max(this->agents, 1u) << " connections";
+    if (this->agents > 0)
+        std::cout << " on " << this->agents << " agents";
+    std::cout << " in " << this->elapsedSeconds << "s" << KXHTTP_CONSOLE_RESET << "\n\n";
+
+    std::cout << (errors == 0 ? KXHTTP_CONSOLE_GREEN : KXHTTP_CONSOLE_YELLOW)
+              << "Completed: " << latencies.count() << ", Failed: " << errors << KXHTTP_CONSOLE_RESET << "\n";
+    std::cout << "Throughput: " << (this->elapsedSeconds > 0 ? latencies.count() / this->elapsedSeconds : 0)
+              << " req/s, " << bodyBytes << " body bytes received\n";
+
+    std::cout << "\nLatency (ms): \n\n";
+    printLatencyLine(latencies);
+
+    if (this->scenarios.size() > 1) {
+        std::cout << "\nEndpoints (ms): \n";
+        for (size_t i = 0; i < this->scenarios.size(); i++) {
+            std::cout << "\n" << KXHTTP_CONSOLE_BLUE << this->scenarios[i].name << KXHTTP_CONSOLE_RESET
+                      << "  (" << perScenario[i].count() << " requests)\n";
+            printLatencyLine(perScenario[i]);
+        }
+    }
+
+    if (!this->options.stages.empty())
+        this->printStages();
+
+    std::cout << "\nLatency Distribution (ms): \n\n";
+    printDistribution(latencies);
+
+    std::cout << "\nStatus Codes: \n\n";
+    for (const auto& entry : statusCounts)
+        std::cout << entry.first << ": " << entry.second << "\n";
+    std::cout << std::endl;
+}
+
+void KxHTTP::Bench::printStages() const
+{
+    std::cout << "\nStages (ms): \n";
+    for (size_t i = 0; i < this->options.stages.size(); i++) {
+        LatencyHistogram latencies;
+        uint64_t errors = 0;
+        for (const auto& stats : this->workerStats) {
+            latencies.merge(stats.stageLatencies[i]);
+            errors += stats.stageErrors[i];
+        }
+
+        const BenchStage& stage = this->options.stages[i];
+        double planned = this->stageCount[i + 1] - this->stageCount[i];
+        std::cout << "\n" << KXHTTP_CONSOLE_BLUE << "Stage " << i + 1 << ": " << this->stageFrom[i] << " -> "
+                  << stage.rate << " req/s over " << stage.seconds << "s" << KXHTTP_CONSOLE_RESET << "\n";
+        std::cout << "Planned: " << static_cast<uint64_t>(planned) << ", Completed: " << latencies.count()
+                  << ", Failed: " << errors << ", Achieved: "
+                  << (stage.seconds > 0 ? latencies.count() / stage.seconds : 0) << " req/s\n";
+        printLatencyLine(latencies);
+    }
+}
+
+double KxHTTP::findMaxRate(const std::vector<KxHTTP::BenchScenario>& scenarios, const KxHTTP::BenchOptions& options,
+                           const KxHTTP::FindMaxOptions& search)
+{
+    std::ostringstream label;
+    label << "p" << search.slo.quantile * 100;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << KXHTTP_CONSOLE_YELLOW << "Searching for the highest rate with " << label.str()
+              << " <= " << search.slo.limitMs << "ms, " << search.probeSeconds << "s per probe"
+              << KXHTTP_CONSOLE_RESET << "\n\n";
+
+    double passed = 0;
+    double failed = 0; // 0 until a probe breaks the SLO
+    double rate = std::max(search.startRate, 1.0);
+
+    for (int probe = 1; probe <= KXHTTP_FIND_MAX_PROBES; probe++) {
+        BenchOptions probeOptions = options;
+        probeOptions.stages = { { rate, search.probeSeconds } };
+        probeOptions.rampFromZero = false;
+
+        Bench runner(scenarios, probeOptions);
+        runner.run();
+
+        LatencyHistogram latencies = runner.latency();
+        uint64_t errors = runner.failures();
+        uint64_t total = latencies.count() + errors;
+        double observed = latencies.percentile(search.slo.quantile) / 1000.0;
+        double achieved = runner.elapsed() > 0 ? total / runner.elapsed() : 0;
+
+        // Latency is measured from each request's slot, so a client or server that
+        // falls behind the rate shows up here rather than as a lower achieved rate
+        bool ok = total > 0 && observed <= search.slo.limitMs
+                  && errors <= total * KXHTTP_FIND_MAX_ERROR_RATE;
+
+        std::cout << "Probe " << probe << ": " << rate << " req/s -> " << label.str() << " "
+                  << observed << "ms, " << errors << " failed, " << achieved << " req/s achieved  "
+                  << (ok ? KXHTTP_CONSOLE_GREEN "ok" : KXHTTP_CONSOLE_RED "breach") << KXHTTP_CONSOLE_RESET << "\n";
+
+        if (ok)
+            passed = rate;
+        else
+            failed = rate;
+
+        // Double until the first breach, then bisect the bracket
+        if (failed == 0) {
+            rate *= 2;
+            continue;
+        }
+        if (failed - passed <= std::max(1.0, passed * KXHTTP_FIND_MAX_PRECISION))
+            break;
+        rate = std::floor((passed + failed) / 2);
+    }
+
+    if (passed > 0)
+        std::cout << "\n" << KXHTTP_CONSOLE_GREEN << "Max sustainable rate: " << passed << " req/s"
+                  << KXHTTP_CONSOLE_RESET << "\n" << std::endl;
+    else
+        std::cout << "\n" << KXHTTP_CONSOLE_RED << "No probed rate met the SLO" << KXHTTP_CONSOLE_RESET << "\n" << std::endl;
+    return passed;
+}
@@ -0,0 +1,194 @@
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "kxhttp/body.h"
+
+//
+// MappedFile Class Implementations
+//
+
+#ifdef _WIN32
+
+KxHTTP::MappedFile::MappedFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("File '" + path + "' not found!");
+    this->contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+KxHTTP::MappedFile::~MappedFile() = default;
+
+const char *KxHTTP::MappedFile::data() const
+{
+    return this->contents.data();
+}
+
+size_t KxHTTP::MappedFile::size() const
+{
+    return this->contents.size();
+}
+
+int KxHTTP::MappedFile::descriptor() const
+{
+    return -1;
+}
+
+#else
+
+KxHTTP::MappedFile::MappedFile(const std::string& path)
+{
+    this->addr = nullptr;
+    this->length = 0;
+    this->fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (this->fd == -1)
+        throw std::runtime_error("File '" + path + "' not found!");
+
+    struct stat sb;
+    if (fstat(this->fd, &sb) == -1 || !S_ISREG(sb.st_mode)) {
+        ::close(this->fd);
+        throw std::runtime_error("File '" + path + "' is not a regular file!");
+    }
+    this->length = static_cast<size_t>(sb.st_size);
+
+    // mmap() refuses empty mappings, an empty file is simply an empty part
+    if (this->length > 0) {
+        void *p = ::mmap(nullptr, this->length, PROT_READ, MAP_PRIVATE, this->fd, 0);
+        if (p == MAP_FAILED) {
+            ::close(this->fd);
+            throw std::runtime_error("Failed to map file '" + path + "'");
+        }
+        this->addr = p;
+        madvise(this->addr, this->length, MADV_SEQUENTIAL);
+    }
+}
+
+KxHTTP::MappedFile::~MappedFile()
+{
+    if (this->addr != nullptr)
+        munmap(this->addr, this->length);
+    ::close(this->fd);
+}
+
+const char *KxHTTP::MappedFile::data() const
+{
+    return static_cast<const char *>(this->addr);
+}
+
+size_t KxHTTP::MappedFile::size() const
+{
+    return this->length;
+}
+
+int KxHTTP::MappedFile::descriptor() const
+{
+    return this->fd;
+}
+
+#endif
+
+//
+// Body Class Implementations
+//
+
+KxHTTP::Body::Body(std::string data)
+{
+    this->append(std::move(data));
+}
+
+std::vector<KxHTTP::Body::Part>& KxHTTP::Body::mutableParts()
+{
+    // Copy-on-write, appending never changes a body someone else is holding
+    if (!this->parts)
+        this->parts = std::make_shared<std::vector<Part>>();
+    else if (this->parts.use_count() > 1)
+        this->parts = std::make_shared<std::vector<Part>>(*this->parts);
+    return *this->parts;
+}
+
+void KxHTTP::Body::append(std::string data)
+{
+    if (data.empty())
+        return;
+
+    this->length += data.size();
+    auto& list = this->mutableParts();
+
+    // Small neighbouring strings are merged so a multipart body stays a short iovec list
+    if (!list.empty() && !list.back().file)
+        list.back().bytes.append(data);
+    else
+        list.push_back({ std::move(data), nullptr });
+}
+
+void KxHTTP::Body::appendFile(std::shared_ptr<const KxHTTP::MappedFile> file)
+{
+    this->length += file->size();
+    this->mutableParts().push_back({ std::string(), std::move(file) });
+}
+
+size_t KxHTTP::Body::size() const
+{
+    return this->length;
+}
+
+bool KxHTTP::Body::empty() const
+{
+    return this->length == 0;
+}
+
+bool KxHTTP::Body::isContiguous() const
+{
+    return !this->parts || this->parts->empty() || (this->parts->size() == 1 && !this->parts->front().file);
+}
+
+std::string_view KxHTTP::Body::view() const
+{
+    if (!this->parts || this->parts->empty() || !this->isContiguous())
+        return {};
+    return this->parts->front().bytes;
+}
+
+void KxHTTP::Body::gather(std::vector<struct iovec>& iov) const
+{
+    if (!this->parts)
+        return;
+
+    for (const auto& part : *this->parts) {
+        if (part.file) {
+            if (part.file->size() > 0)
+                iov.push_back({ const_cast<char *>(part.file->data()), part.file->size() });
+        } else {
+            iov.push_back({ const_cast<char *>(part.bytes.data()), part.bytes.size() });
+        }
+    }
+}
+
+const std::vector<KxHTTP::Body::Part>& KxHTTP::Body::getParts() const
+{
+    static const std::vector<Part> none;
+    return this->parts ? *this->parts : none;
+}
+
+std::string KxHTTP::Body::flatten() const
+{
+    std::string out;
+    out.reserve(this->length);
+    if (this->parts) {
+        for (const auto& part : *this->parts) {
+            if (part.file)
+                out.append(part.file->data(), part.file->size());
+            else
+                out.append(part.bytes);
+        }
+    }
+    return out;
+}
@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "kxhttp.h"
+
+namespace
+{
+#ifndef _WIN32
+    std::string encodeRequest(const KxHTTP::RequestData& rd)
+    {
+        std::string out;
+        KxHTTP::putU32(out, KXHTTP_DAEMON_PROTOCOL);
+        KxHTTP::encodeRequestData(out, rd);
+        return out;
+    }
+
+    // Requests carry credentials, so both ends only talk to their own user
+    bool sameUser(int fd)
+    {
+#if defined(SO_PEERCRED)
+        struct ucred cred;
+        socklen_t length = sizeof(cred);
+        return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &length) == 0 && cred.uid == geteuid();
+#else
+        uid_t uid;
+        gid_t gid;
+        return getpeereid(fd, &uid, &gid) == 0 && uid == geteuid();
+#endif
+    }
+
+    int connectUnix(const std::string& path)
+    {
+        struct sockaddr_un addr {};
+        if (path.size() >= sizeof(addr.sun_path))
+            return -1;
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd == -1)
+            return -1;
+        if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == -1) {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    // Hands what is written to it to the client in REPLY_MORE frames of
+    // KXHTTP_DAEMON_REPLY_CHUNK bytes, so output of any size gets through
+    class ReplyStream : public std::streambuf
+    {
+        public:
+            explicit ReplyStream(int fd) : fd(fd) {}
+
+            // The last frame: REPLY_OK with the rest of the output, or anything
+            // else after the output so far
+            void finish(KxHTTP::ReplyStatus status, const std::string& message)
+            {
+                if (status != KxHTTP::REPLY_OK && !this->pending.empty())
+                    this->send(KxHTTP::REPLY_MORE);
+                if (status != KxHTTP::REPLY_OK)
+                    this->pending = message;
+                this->send(status);
+            }
+
+        protected:
+            int_type overflow(int_type c) override
+            {
+                if (traits_type::eq_int_type(c, traits_type::eof()))
+                    return traits_type::not_eof(c);
+                char ch = traits_type::to_char_type(c);
+                return this->xsputn(&ch, 1) == 1 ? c : traits_type::eof();
+            }
+
+            std::streamsize xsputn(const char *s, std::streamsize n) override
+            {
+                size_t left = static_cast<size_t>(n);
+                while (left > 0) {
+                    size_t take = std::min(left, KXHTTP_DAEMON_REPLY_CHUNK - this->pending.size());
+                    this->pending.append(s, take);
+                    s += take;
+                    left -= take;
+                    if (this->pending.size() == KXHTTP_DAEMON_REPLY_CHUNK && !this->send(KxHTTP::REPLY_MORE))
+                        return n - static_cast<std::streamsize>(left);
+                }
+                return n;
+            }
+
+        private:
+            // A client that went away fails the stream, the request still finishes
+            bool send(KxHTTP::ReplyStatus status)
+            {
+                std::string frame;
+                KxHTTP::putU32(frame, status);
+                KxHTTP::putString(frame, this->pending);
+                this->pending.clear();
+                this->broken = this->broken || !KxHTTP::sendFrame(this->fd, frame);
+                return !this->broken;
+            }
+
+            int fd;
+            std::string pending;
+            bool broken = false;
+    };
+#endif
+}
+
+std::string KxHTTP::daemonSocketPath()
+{
+    if (const char *path = std::getenv("KXH_DAEMON_SOCKET"))
+        return path;
+#ifdef _WIN32
+    return std::string();
+#else
+    if (const char *runtime = std::getenv("XDG_RUNTIME_DIR"))
+        return std::string(runtime) + "/kxh.sock";
+    return "/tmp/kxh-" + std::to_string(geteuid()) + ".sock";
+#endif
+}
+
+//
+// Daemon Class Implementations
+//
+
+KxHTTP::Daemon::Daemon(const std::string& socketPath)
+{
+    this->socketPath = socketPath;
+    this->listener = -1;
+}
+
+KxHTTP::Daemon::~Daemon()
+{
+#ifndef _WIN32
+    if (this->listener != -1) {
+        ::close(this->listener);
+        unlink(this->socketPath.c_str());
+    }
+#endif
+}
+
+void KxHTTP::Daemon::run()
+{
+#ifdef _WIN32
+    throw std::runtime_error("Daemon mode is not supported on this platform");
+#else
+    struct sockaddr_un addr {};
+    if (this->socketPath.empty() || this->socketPath.size() >= sizeof(addr.sun_path))
+        throw std::runtime_error("Invalid daemon socket path: " + this->socketPath);
+
+    // A socket file nobody answers on is left over from a daemon that was killed
+    int existing = connectUnix(this->socketPath);
+    if (existing != -1) {
+        ::close(existing);
+        throw std::runtime_error("A daemon is already listening on " + this->socketPath);
+    }
+    unlink(this->socketPath.c_str());
+
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, this->socketPath.c_str(), this->socketPath.size() + 1);
+
+    this->listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (this->listener == -1)
+        throw std::runtime_error("Failed to create the daemon socket");
+
+    // Owner-only, the socket accepts requests with the user's credentials
+    mode_t previous = umask(0077);
+    int bound = bind(this->listener, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr));
+    umask(previous);
+    if (bound == -1 || listen(this->listener, SOMAXCONN) == -1) {
+        ::close(this->listener);
+        this->listener = -1;
+        throw std::runtime_error("Failed to listen on " + this->socketPath);
+    }
+
+    std::cout << KXHTTP_CONSOLE_GREEN << "kxh daemon listening on " << this->socketPath << KXHTTP_CONSOLE_RESET << std::endl;
+
+    while (true) {
+        int client = httplib::detail::handle_EINTR([&]() { return accept4(this->listener, nullptr, nullptr, SOCK_CLOEXEC); });
+        if (client == -1)
+            continue;
+        std::thread(&Daemon::serve, this, client).detach();
+    }
+#endif
+}
+
+void KxHTTP::Daemon::serve(int client)
+{
+#ifndef _WIN32
+    std::string frame;
+    if (!sameUser(client) || !receiveFrame(client, frame, KXHTTP_DAEMON_MAX_FRAME)) {
+        ::close(client);
+        return;
+    }
+
+    ReplyStream reply(client);
+    try {
+        FrameReader in{ frame };
+        if (in.u32() != KXHTTP_DAEMON_PROTOCOL) {
+            reply.finish(REPLY_INCOMPATIBLE, std::string());
+        } else {
+            HTTPRequest rq(decodeRequestData(in));
+            rq.sendRequest(this->pool);
+
+            std::ostream output(&reply);
+            rq.processResponse(output);
+            reply.finish(REPLY_OK, std::string());
+        }
+    } catch (const std::exception& e) {
+        reply.finish(REPLY_ERROR, e.what());
+    }
+    ::close(client);
+#else
+    (void)client;
+#endif
+}
+
+bool KxHTTP::forwardToDaemon(const KxHTTP::RequestData& rd, std::ostream& out, std::string& error)
+{
+#ifdef _WIN32
+    (void)rd;
+    (void)out;
+    (void)error;
+    return false;
+#else
+    int fd = connectUnix(daemonSocketPath());
+    if (fd == -1)
+        return false;
+
+    if (!sameUser(fd) || !sendFrame(fd, encodeRequest(rd))) {
+        ::close(fd);
+        return false;
+    }
+
+    // The output comes in pieces, each written as soon as it arrives
+    bool wrote = false;
+    while (true) {
+        // The daemon may already have sent the request, so it is not run a second time
+        std::string reply;
+        if (!receiveFrame(fd, reply, KXHTTP_DAEMON_MAX_FRAME)) {
+            ::close(fd);
+            error = "Lost the connection to the kxh daemon";
+            return true;
+        }
+
+        uint32_t status;
+        std::string piece;
+        try {
+            FrameReader in{ reply };
+            status = in.u32();
+            piece = in.string();
+        } catch (const std::runtime_error&) {
+            status = REPLY_INCOMPATIBLE;
+        }
+
+        // A daemon from another version or a broken reply: run the request here
+        // instead, unless part of the daemon's output is already out
+        if (status != REPLY_OK && status != REPLY_ERROR && status != REPLY_MORE) {
+            ::close(fd);
+            if (!wrote)
+                return false;
+            error = "Lost the connection to the kxh daemon";
+            return true;
+        }
+
+        if (status == REPLY_ERROR) {
+            ::close(fd);
+            error = piece;
+            return true;
+        }
+
+        out.write(piece.data(), static_cast<std::streamsize>(piece.size()));
+        wrote = true;
+        if (status == REPLY_OK) {
+            ::close(fd);
+            out.flush();
+            return true;
+        }
+    }
+#endif
+}
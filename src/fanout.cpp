@@ -0,0 +1,63 @@
+#include <atomic>
+#include <sstream>
+#include <thread>
+
+#include "kxhttp.h"
+
+//
+// FanOut Class Implementations
+//
+
+KxHTTP::FanOut::FanOut(KxHTTP::RequestData&& base, std::vector<std::string> urls, unsigned parallel, bool ordered)
+{
+    if (!base.outputFile.empty())
+        throw std::runtime_error("-o can only be used with a single URL");
+
+    this->format = base.format;
+    this->summary = base.summary;
+    this->urls = std::move(urls);
+    this->parallel = std::max(1u, std::min<unsigned>(parallel, static_cast<unsigned>(this->urls.size())));
+    this->ordered = ordered;
+
+    // Headers and body are built once here, every URL then shares them
+    this->prototype = std::make_unique<HTTPRequest>(std::move(base));
+    this->prototype->preparePayload();
+}
+
+void KxHTTP::FanOut::run(std::ostream& out)
+{
+    // Workers hand finished results to the sink, which prints them in input
+    // order (or as they finish) without any worker waiting on the stream
+    OutputSink sink(out, this->ordered);
+    std::atomic<size_t> next(0);
+
+    auto worker = [&]() {
+        size_t i;
+        while ((i = next.fetch_add(1)) < this->urls.size()) {
+            std::ostringstream result;
+            HTTPRequest rq(*this->prototype, this->urls[i]);
+            try {
+                rq.sendRequest(this->pool);
+                rq.processResponse(result);
+            } catch (const std::exception& e) {
+                if (this->format != OUTPUT_TEXT)
+                    rq.processError(result, e.what());
+                else
+                    result << KXHTTP_CONSOLE_RED << "Error: " << this->urls[i] << ": " << e.what() << KXHTTP_CONSOLE_RESET << "\n";
+            }
+
+            // Records and summaries already end their line, full text results are kept apart by a blank one
+            if (this->format == OUTPUT_TEXT && !this->summary)
+                result << "\n";
+            sink.submit(i, result.str());
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < this->parallel; t++)
+        threads.emplace_back(worker);
+
+    for (auto& t : threads)
+        t.join();
+    sink.close();
+}
@@ -0,0 +1,233 @@
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "kxhttp.h"
+
+namespace
+{
+    // The receiving process may run with another cwd, so paths are sent absolute
+    std::string absolutePath(const std::string& path)
+    {
+#ifdef _WIN32
+        return path;
+#else
+        if (path.empty() || path[0] == '/')
+            return path;
+        char cwd[4096];
+        if (getcwd(cwd, sizeof(cwd)) == nullptr)
+            return path;
+        return std::string(cwd) + "/" + path;
+#endif
+    }
+
+#ifndef _WIN32
+    bool writeAll(int fd, const char *data, size_t size)
+    {
+        while (size > 0) {
+            ssize_t n = httplib::detail::handle_EINTR([&]() { return send(fd, data, size, MSG_NOSIGNAL); });
+            if (n <= 0)
+                return false;
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool readAll(int fd, char *data, size_t size)
+    {
+        while (size > 0) {
+            ssize_t n = httplib::detail::handle_EINTR([&]() { return recv(fd, data, size, 0); });
+            if (n <= 0)
+                return false;
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+#endif
+}
+
+void KxHTTP::putU32(std::string& out, uint32_t v)
+{
+    char bytes[4] = { char(v & 0xff), char((v >> 8) & 0xff), char((v >> 16) & 0xff), char((v >> 24) & 0xff) };
+    out.append(bytes, 4);
+}
+
+void KxHTTP::putU64(std::string& out, uint64_t v)
+{
+    putU32(out, static_cast<uint32_t>(v));
+    putU32(out, static_cast<uint32_t>(v >> 32));
+}
+
+void KxHTTP::putDouble(std::string& out, double v)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    putU64(out, bits);
+}
+
+void KxHTTP::putString(std::string& out, const std::string& s)
+{
+    putU32(out, static_cast<uint32_t>(s.size()));
+    out.append(s);
+}
+
+void KxHTTP::putStrings(std::string& out, const std::vector<std::string>& list)
+{
+    putU32(out, static_cast<uint32_t>(list.size()));
+    for (const auto& s : list)
+        putString(out, s);
+}
+
+//
+// FrameReader Struct Implementations
+//
+
+uint32_t KxHTTP::FrameReader::u32()
+{
+    if (this->in.size() - this->pos < 4)
+        throw std::runtime_error("Truncated frame");
+    auto *p = reinterpret_cast<const unsigned char *>(this->in.data() + this->pos);
+    this->pos += 4;
+    return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+}
+
+uint64_t KxHTTP::FrameReader::u64()
+{
+    uint64_t low = this->u32();
+    return low | uint64_t(this->u32()) << 32;
+}
+
+double KxHTTP::FrameReader::f64()
+{
+    uint64_t bits = this->u64();
+    double v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+std::string KxHTTP::FrameReader::string()
+{
+    uint32_t length = this->u32();
+    if (this->in.size() - this->pos < length)
+        throw std::runtime_error("Truncated frame");
+    std::string s(this->in.substr(this->pos, length));
+    this->pos += length;
+    return s;
+}
+
+std::vector<std::string> KxHTTP::FrameReader::strings()
+{
+    uint32_t count = this->u32();
+    if (count > this->in.size() - this->pos)
+        throw std::runtime_error("Truncated frame");
+    std::vector<std::string> list(count);
+    for (auto& s : list)
+        s = this->string();
+    return list;
+}
+
+void KxHTTP::encodeRequestData(std::string& out, const KxHTTP::RequestData& rd)
+{
+    std::vector<std::string> formFiles;
+    for (const auto& formFile : rd.formFiles) {
+        auto delimiterPos = formFile.find('=');
+        formFiles.push_back(delimiterPos == std::string::npos ? formFile
+                : formFile.substr(0, delimiterPos + 1) + absolutePath(formFile.substr(delimiterPos + 1)));
+    }
+
+    putU32(out, static_cast<uint32_t>(rd.method));
+    putString(out, rd.url);
+    putStrings(out, rd.formData);
+    putStrings(out, formFiles);
+    putStrings(out, rd.jsonData);
+    putString(out, absolutePath(rd.jsonFile));
+    putString(out, !rd.dataBinary.empty() && rd.dataBinary[0] == '@'
+            ? "@" + absolutePath(rd.dataBinary.substr(1)) : rd.dataBinary);
+    putStrings(out, rd.headers);
+    putStrings(out, rd.cookies);
+    putString(out, rd.authData);
+    putString(out, rd.authDigest);
+    putString(out, rd.authBearerToken);
+    putString(out, absolutePath(rd.outputFile));
+    putString(out, absolutePath(rd.unixSocket));
+
+    const ConnectionOptions& o = rd.connection;
+    putU32(out, static_cast<uint32_t>(o.readBufferSize));
+    putU32(out, (o.adaptiveRead ? 1u : 0u) | (o.tcpNoDelay ? 2u : 0u) | (o.tcpFastOpen ? 4u : 0u) | (o.quickAck ? 8u : 0u));
+    putU32(out, static_cast<uint32_t>(o.busyPoll));
+    putU32(out, static_cast<uint32_t>(o.sendBuffer));
+    putU32(out, static_cast<uint32_t>(o.recvBuffer));
+    putU32(out, static_cast<uint32_t>(o.connectTimeoutMs));
+    putU32(out, static_cast<uint32_t>(o.readTimeoutMs));
+    putU32(out, static_cast<uint32_t>(o.writeTimeoutMs));
+    putU32(out, static_cast<uint32_t>(o.tlsTimeoutMs));
+    putU32(out, static_cast<uint32_t>(o.deadlineMs));
+}
+
+KxHTTP::RequestData KxHTTP::decodeRequestData(KxHTTP::FrameReader& in)
+{
+    RequestData rd;
+    rd.method = static_cast<Method>(in.u32());
+    if (rd.method > HTTP_HEAD)
+        throw std::runtime_error("Unknown HTTP method in frame");
+    rd.url = in.string();
+    rd.formData = in.strings();
+    rd.formFiles = in.strings();
+    rd.jsonData = in.strings();
+    rd.jsonFile = in.string();
+    rd.dataBinary = in.string();
+    rd.headers = in.strings();
+    rd.cookies = in.strings();
+    rd.authData = in.string();
+    rd.authDigest = in.string();
+    rd.authBearerToken = in.string();
+    rd.outputFile = in.string();
+    rd.unixSocket = in.string();
+
+    ConnectionOptions& o = rd.connection;
+    o.readBufferSize = in.u32();
+    uint32_t flags = in.u32();
+    o.adaptiveRead = flags & 1u;
+    o.tcpNoDelay = flags & 2u;
+    o.tcpFastOpen = flags & 4u;
+    o.quickAck = flags & 8u;
+    o.busyPoll = static_cast<int>(in.u32());
+    o.sendBuffer = static_cast<int>(in.u32());
+    o.recvBuffer = static_cast<int>(in.u32());
+    o.connectTimeoutMs = static_cast<int>(in.u32());
+    o.readTimeoutMs = static_cast<int>(in.u32());
+    o.writeTimeoutMs = static_cast<int>(in.u32());
+    o.tlsTimeoutMs = static_cast<int>(in.u32());
+    o.deadlineMs = static_cast<int>(in.u32());
+    return rd;
+}
+
+#ifndef _WIN32
+
+bool KxHTTP::sendFrame(int fd, const std::string& payload)
+{
+    std::string length;
+    putU32(length, static_cast<uint32_t>(payload.size()));
+    return writeAll(fd, length.data(), length.size()) && writeAll(fd, payload.data(), payload.size());
+}
+
+bool KxHTTP::receiveFrame(int fd, std::string& payload, uint32_t maxSize)
+{
+    char length[4];
+    if (!readAll(fd, length, sizeof(length)))
+        return false;
+    FrameReader header{ std::string_view(length, sizeof(length)) };
+    uint32_t size = header.u32();
+    if (size > maxSize)
+        return false;
+    payload.resize(size);
+    return readAll(fd, payload.data(), size);
+}
+
+#endif
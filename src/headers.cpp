@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include "kxhttp/headers.h"
+
+//
+// Arena Class Implementations
+//
+
+char *KxHTTP::Arena::allocate(size_t n)
+{
+    if (n > this->remaining) {
+        // Oversized strings get a block of their own so we don't waste the tail
+        size_t blockSize = std::max<size_t>(n, KXHTTP_ARENA_INLINE_SIZE * 4);
+        this->blocks.emplace_back(new char[blockSize]);
+        this->cursor = this->blocks.back().get();
+        this->remaining = blockSize;
+    }
+
+    char *p = this->cursor;
+    this->cursor += n;
+    this->remaining -= n;
+    return p;
+}
+
+std::string_view KxHTTP::Arena::store(std::string_view s)
+{
+    if (s.empty())
+        return {};
+
+    char *p = this->allocate(s.size());
+    std::memcpy(p, s.data(), s.size());
+    return {p, s.size()};
+}
+
+std::string_view KxHTTP::Arena::storeLower(std::string_view s)
+{
+    if (s.empty())
+        return {};
+
+    char *p = this->allocate(s.size());
+    for (size_t i = 0; i < s.size(); i++)
+        p[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(s[i])));
+    return {p, s.size()};
+}
+
+void KxHTTP::Arena::clear()
+{
+    this->blocks.clear();
+    this->cursor = this->inlineBlock;
+    this->remaining = KXHTTP_ARENA_INLINE_SIZE;
+}
+
+//
+// HeaderList Class Implementations
+//
+
+KxHTTP::HeaderList::HeaderList(const KxHTTP::HeaderList& other)
+{
+    for (const auto& header : other)
+        this->add(header.name, header.value);
+}
+
+KxHTTP::HeaderList& KxHTTP::HeaderList::operator=(const KxHTTP::HeaderList& other)
+{
+    if (this != &other) {
+        this->clear();
+        for (const auto& header : other)
+            this->add(header.name, header.value);
+    }
+    return *this;
+}
+
+void KxHTTP::HeaderList::add(std::string_view name, std::string_view value)
+{
+    Header header { this->arena.store(name), this->arena.storeLower(name), this->arena.store(value) };
+
+    if (this->length < KXHTTP_HEADER_INLINE_CAPACITY) {
+        this->inlineItems[this->length++] = header;
+        return;
+    }
+
+    // Spill to the heap once the inline slots are used up
+    if (this->heapItems.empty()) {
+        this->heapItems.reserve(KXHTTP_HEADER_INLINE_CAPACITY * 2);
+        this->heapItems.assign(this->inlineItems, this->inlineItems + this->length);
+    }
+    this->heapItems.push_back(header);
+    this->items = this->heapItems.data();
+    this->length++;
+}
+
+bool KxHTTP::HeaderList::has(std::string_view name) const
+{
+    return std::any_of(this->begin(), this->end(), [name](const Header& h) {
+        return equalsLower(h.lowerName, name);
+    });
+}
+
+std::string_view KxHTTP::HeaderList::get(std::string_view name, std::string_view def) const
+{
+    for (const auto& header : *this) {
+        if (equalsLower(header.lowerName, name))
+            return header.value;
+    }
+    return def;
+}
+
+size_t KxHTTP::HeaderList::count(std::string_view name) const
+{
+    return static_cast<size_t>(std::count_if(this->begin(), this->end(), [name](const Header& h) {
+        return equalsLower(h.lowerName, name);
+    }));
+}
+
+void KxHTTP::HeaderList::clear()
+{
+    this->arena.clear();
+    this->heapItems.clear();
+    this->items = this->inlineItems;
+    this->length = 0;
+}
+
+void KxHTTP::HeaderList::serialize(std::string& out) const
+{
+    for (const auto& header : *this) {
+        out.append(header.name);
+        out.append(": ");
+        out.append(header.value);
+        out.append("\r\n");
+    }
+}
+
+bool KxHTTP::equalsLower(std::string_view lowerName, std::string_view s)
+{
+    if (lowerName.size() != s.size())
+        return false;
+
+    for (size_t i = 0; i < s.size(); i++) {
+        if (lowerName[i] != static_cast<char>(std::tolower(static_cast<unsigned char>(s[i]))))
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "kxhttp.h"
+
+namespace
+{
+    bool parseDelay(std::string delay, double& ms)
+    {
+        return KxHTTP::durationTransformer()(delay).empty() && CLI::detail::lexical_cast(delay, ms) && ms >= 0;
+    }
+}
+
+//
+// HedgePolicy Class Implementations
+//
+
+void KxHTTP::HedgePolicy::configure(const std::string& spec)
+{
+    const std::string invalid = "Invalid --hedge-after '" + spec + "', expected a delay or a percentile like p95 or p95,200ms";
+    if (!spec.empty() && spec[0] == 'p') {
+        auto comma = spec.find(',');
+        double percent = 0;
+        if (!CLI::detail::lexical_cast(spec.substr(1, comma - 1), percent) || percent <= 0 || percent >= 100)
+            throw std::runtime_error(invalid);
+        if (comma != std::string::npos && !parseDelay(spec.substr(comma + 1), this->fallbackMs))
+            throw std::runtime_error(invalid);
+        this->quantile = percent / 100;
+        return;
+    }
+
+    if (!parseDelay(spec, this->fixedMs))
+        throw std::runtime_error(invalid);
+}
+
+bool KxHTTP::HedgePolicy::enabled() const
+{
+    return this->fixedMs >= 0 || this->quantile > 0;
+}
+
+bool KxHTTP::HedgePolicy::needsSamples() const
+{
+    return this->quantile > 0 && this->fallbackMs < 0;
+}
+
+int KxHTTP::HedgePolicy::delayMs() const
+{
+    if (this->fixedMs >= 0)
+        return static_cast<int>(std::ceil(this->fixedMs));
+    if (this->quantile <= 0)
+        return -1;
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->observed.count() < KXHTTP_HEDGE_MIN_SAMPLES)
+        return this->fallbackMs >= 0 ? static_cast<int>(std::ceil(this->fallbackMs)) : -1;
+    // poll() counts in milliseconds, a 0 would duplicate every request
+    return std::max(1, static_cast<int>(std::ceil(this->observed.percentile(this->quantile) / 1000.0)));
+}
+
+void KxHTTP::HedgePolicy::record(uint32_t micros)
+{
+    if (this->quantile <= 0)
+        return;
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->observed.record(micros);
+}
+
+KxHTTP::HedgePolicy& KxHTTP::hedgePolicy()
+{
+    static HedgePolicy policy;
+    return policy;
+}
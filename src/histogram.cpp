@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "kxhttp/frame.h"
+#include "kxhttp/histogram.h"
+
+namespace
+{
+    // Values below SUB_BUCKETS are exact, each power of two above that is
+    // split into SUB_BUCKETS / 2 linear steps
+    constexpr uint32_t subBuckets = KXHTTP_HISTOGRAM_SUB_BUCKETS;
+    constexpr uint32_t halfBuckets = subBuckets / 2;
+    constexpr int subBits = 7; // log2(subBuckets)
+    constexpr size_t bucketCount = subBuckets + (32 - subBits) * halfBuckets;
+
+    int highestBit(uint32_t v)
+    {
+        int bit = 0;
+        while (v >>= 1)
+            bit++;
+        return bit;
+    }
+}
+
+//
+// LatencyHistogram Class Implementations
+//
+
+KxHTTP::LatencyHistogram::LatencyHistogram()
+{
+    this->counts.assign(bucketCount, 0);
+    this->total = 0;
+    this->sum = 0;
+    this->lowest = UINT32_MAX;
+    this->highest = 0;
+}
+
+size_t KxHTTP::LatencyHistogram::indexOf(uint32_t micros)
+{
+    if (micros < subBuckets)
+        return micros;
+
+    // micros >> shift lands in [halfBuckets, subBuckets)
+    int shift = highestBit(micros) - (subBits - 1);
+    return subBuckets + static_cast<size_t>(shift - 1) * halfBuckets + ((micros >> shift) - halfBuckets);
+}
+
+uint32_t KxHTTP::LatencyHistogram::valueAt(size_t index)
+{
+    if (index < subBuckets)
+        return static_cast<uint32_t>(index);
+
+    // Middle of the bucket, which halves the worst-case error
+    size_t rest = index - subBuckets;
+    int shift = static_cast<int>(rest / halfBuckets) + 1;
+    uint64_t low = static_cast<uint64_t>(rest % halfBuckets + halfBuckets) << shift;
+    return static_cast<uint32_t>(std::min<uint64_t>(low + (uint64_t(1) << shift) / 2, UINT32_MAX));
+}
+
+void KxHTTP::LatencyHistogram::record(uint32_t micros)
+{
+    this->counts[indexOf(micros)]++;
+    this->total++;
+    this->sum += micros;
+    this->lowest = std::min(this->lowest, micros);
+    this->highest = std::max(this->highest, micros);
+}
+
+void KxHTTP::LatencyHistogram::merge(const KxHTTP::LatencyHistogram& other)
+{
+    for (size_t i = 0; i < bucketCount; i++)
+        this->counts[i] += other.counts[i];
+    this->total += other.total;
+    this->sum += other.sum;
+    this->lowest = std::min(this->lowest, other.lowest);
+    this->highest = std::max(this->highest, other.highest);
+}
+
+void KxHTTP::LatencyHistogram::clear()
+{
+    std::fill(this->counts.begin(), this->counts.end(), 0);
+    this->total = 0;
+    this->sum = 0;
+    this->lowest = UINT32_MAX;
+    this->highest = 0;
+}
+
+uint64_t KxHTTP::LatencyHistogram::count() const
+{
+    return this->total;
+}
+
+uint32_t KxHTTP::LatencyHistogram::min() const
+{
+    return this->total == 0 ? 0 : this->lowest;
+}
+
+uint32_t KxHTTP::LatencyHistogram::max() const
+{
+    return this->highest;
+}
+
+double KxHTTP::LatencyHistogram::mean() const
+{
+    return this->total == 0 ? 0 : static_cast<double>(this->sum) / static_cast<double>(this->total);
+}
+
+uint32_t KxHTTP::LatencyHistogram::percentile(double p) const
+{
+    if (this->total == 0)
+        return 0;
+
+    // Same nearest-rank rule the sorted-vector report used, clamped to what was seen
+    uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(this->total - 1));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < bucketCount; i++) {
+        seen += this->counts[i];
+        if (seen > rank)
+            return std::clamp(valueAt(i), this->lowest, this->highest);
+    }
+    return this->highest;
+}
+
+void KxHTTP::LatencyHistogram::serialize(std::string& out) const
+{
+    uint32_t used = 0;
+    for (size_t i = 0; i < bucketCount; i++)
+        used += this->counts[i] != 0;
+
+    putU32(out, static_cast<uint32_t>(bucketCount));
+    putU64(out, this->total);
+    putU64(out, this->sum);
+    putU32(out, this->lowest);
+    putU32(out, this->highest);
+    putU32(out, used);
+    for (size_t i = 0; i < bucketCount; i++) {
+        if (this->counts[i] != 0) {
+            putU32(out, static_cast<uint32_t>(i));
+            putU64(out, this->counts[i]);
+        }
+    }
+}
+
+void KxHTTP::LatencyHistogram::deserialize(KxHTTP::FrameReader& in)
+{
+    // A different layout means a different bucket width, the counts would not line up
+    if (in.u32() != bucketCount)
+        throw std::runtime_error("Incompatible latency histogram layout");
+
+    this->clear();
+    this->total = in.u64();
+    this->sum = in.u64();
+    this->lowest = in.u32();
+    this->highest = in.u32();
+    uint32_t used = in.u32();
+    for (uint32_t i = 0; i < used; i++) {
+        uint32_t index = in.u32();
+        if (index >= bucketCount)
+            throw std::runtime_error("Invalid latency histogram bucket");
+        this->counts[index] = in.u64();
+    }
+}
@@ -1,19 +1,88 @@
-#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
 #include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "kxhttp.h"
 
+// The positionals of a single request, "GET https://..."
+void KxHTTP::addRequestTarget(CLI::App *app, KxHTTP::RequestData& request, std::string& methodStr)
+{
+    app->add_option("HTTP Method", methodStr, "HTTP method (GET, POST,...)");
+    app->add_option("URL", request.url, "URL to send the request to");
+}
+
+// Options shared by every mode that builds a request from the command line
+void KxHTTP::addRequestOptions(CLI::App *app, KxHTTP::RequestData& request)
+{
+    app->add_option("-f,--form", request.formData, "Send form data");
+    app->add_option("--form-file", request.formFiles, "Form file uploads");
+    app->add_option("-j,--json", request.jsonData, "Send raw JSON data");
+    app->add_option("--json-file", request.jsonFile, "Upload a JSON file");
+    app->add_option("--data-binary", request.dataBinary, "Send raw data, or a file with @path");
+    app->add_option("-H,--headers", request.headers, "Send custom headers");
+    app->add_option("-c,--cookies", request.cookies, "Send custom cookies");
+    app->add_option("-a,--auth", request.authData, "Basic Authentication");
+    app->add_option("--auth-digest", request.authDigest, "Digest Authentication");
+    app->add_option("--auth-token", request.authBearerToken, "Bearer Token Authentication");
+    app->add_option("--unix-socket", request.unixSocket, "Connect through a Unix domain socket");
+    app->add_option("--read-buffer", request.connection.readBufferSize, "Read buffer size")
+            ->transform(CLI::AsSizeValue(false))
+            ->check(CLI::Range(size_t(512), KXHTTP_MAX_READ_BUFSIZ));
+    app->add_flag("--adaptive-read", request.connection.adaptiveRead, "Grow the read buffer on bulk transfers");
+    app->add_flag("--tcp-nodelay,!--no-tcp-nodelay", request.connection.tcpNoDelay, "Disable Nagle's algorithm");
+    app->add_flag("--tcp-fastopen", request.connection.tcpFastOpen, "Use TCP Fast Open on connect");
+    app->add_flag("--quickack", request.connection.quickAck, "Acknowledge incoming data immediately");
+    app->add_option("--busy-poll", request.connection.busyPoll, "Busy poll for this many microseconds")
+            ->check(CLI::NonNegativeNumber);
+    app->add_option("--sndbuf", request.connection.sendBuffer, "Socket send buffer size")
+            ->transform(CLI::AsSizeValue(false))
+            ->check(CLI::Range(0, INT32_MAX));
+    app->add_option("--rcvbuf", request.connection.recvBuffer, "Socket receive buffer size")
+            ->transform(CLI::AsSizeValue(false))
+            ->check(CLI::Range(0, INT32_MAX));
+    app->add_option("--connect-timeout", request.connection.connectTimeoutMs, "Connect timeout")
+            ->transform(KxHTTP::durationTransformer())->check(CLI::Range(1, INT32_MAX));
+    app->add_option("--read-timeout", request.connection.readTimeoutMs, "Timeout for each read")
+            ->transform(KxHTTP::durationTransformer())->check(CLI::Range(1, INT32_MAX));
+    app->add_option("--write-timeout", request.connection.writeTimeoutMs, "Timeout for each write")
+            ->transform(KxHTTP::durationTransformer())->check(CLI::Range(1, INT32_MAX));
+    app->add_option("--tls-timeout", request.connection.tlsTimeoutMs, "TLS handshake timeout")
+            ->transform(KxHTTP::durationTransformer())->check(CLI::Range(1, INT32_MAX));
+    app->add_option("--max-time", request.connection.deadlineMs, "Deadline for a whole request")
+            ->transform(KxHTTP::durationTransformer())->check(CLI::Range(1, INT32_MAX));
+}
+
+// Durations such as 250ms, 1.5s or 2m, a bare number is in milliseconds.
+// Timeouts are whole milliseconds, so there is no unit below that
+CLI::AsNumberWithUnit KxHTTP::durationTransformer()
+{
+    return CLI::AsNumberWithUnit(std::map<std::string, double>{ { "ms", 1 }, { "s", 1000 }, { "m", 60000 } },
+                                 CLI::AsNumberWithUnit::CASE_SENSITIVE, "DURATION");
+}
+
 int main(int argc, char ** argv)
 {
     CLI::App app("KxHTTP");
     KxHTTP::RequestData request;
+    KxHTTP::BenchOptions benchOptions;
 
     std::string methodStr;
     const std::string customHelpMessage =
             "KxHTTP " + std::string(KXHTTP_VER) + "\n"
-            "Usage: kxh [HTTP Method] [URL] [Options...]\n\n"
+            "Usage: kxh [HTTP Method] [URL...] [Options...]\n"
+            "       kxh bench [HTTP Method] [URL] [Options...]\n"
+            "       kxh shell [Base URL] [Options...]\n"
+            "       kxh daemon [--socket path]\n"
+            "       kxh agent [--listen address] [--token secret]\n\n"
             "HTTP Methods:\n"
             "  GET, POST, PUT, DELETE, PATCH, OPTIONS, HEAD\n\n"
             "Options:\n"
@@ -21,50 +90,365 @@ int main(int argc, char ** argv)
             "  --form-file [file]        Form file upload (e.g., --form-file \"photo=/path/to/photo.png\")\n"
             "  -j, --json [data]         Send raw JSON data (e.g., -j {\"key\": \"value\"}\n"
             "  --json-file [file]        Upload a JSON file (e.g., --json-file \"/path/data.json\")\n"
+            "  --data-binary [data]      Send raw data, or a file as-is with @ (e.g., --data-binary @/path/image.png)\n"
             "  -H, --headers [headers]   Send custom headers (e.g., -H \"Content-Type: application/json\")\n"
             "  -c, --cookies [cookies]   Send custom cookies (e.g., -c \"value=xyz\")\n"
             "  -a, --auth [credentials]  Basic Authentication (e.g., -a \"username:password\")\n"
             "  --auth-digest [credentials]  Digest Authentication (e.g., --auth-digest \"username:password\")\n"
             "  --auth-token [credentials]  Bearer Token Authentication (e.g., --auth-token \"token\")\n"
-            "  -o, --output [file]       Save output to a file (e.g., -o \"output.txt\")\n\n"
+            "  -o, --output [file]       Save output to a file (e.g., -o \"output.txt\")\n"
+            "  --format [text|json|jsonl]  Print each result as text, an indented JSON object, or one JSON\n"
+            "                            line with status, headers, body size, timings and errors (also for shell)\n"
+            "  -s, --silent, --summary   Print one line with status, body size and timings. The body is\n"
+            "                            counted as it arrives and never kept in memory (also for shell)\n"
+            "  --no-daemon               Run the request here even if a kxh daemon is running\n"
+            "  --parallel [count]        Requests in flight at once when given several URLs (default 8)\n"
+            "  --unordered               Print results from several URLs as they finish, not in input order\n"
+            "  --max-rps [host=rate]     Cap requests per second to a host, repeatable, with an optional\n"
+            "                            burst, e.g. --max-rps api.example.com=50:10 (also for bench and shell)\n"
+            "  --hedge-after [delay|pN]  Send a GET or HEAD again on a second connection when the first\n"
+            "                            has not answered within the delay, or within the pN latency seen\n"
+            "                            so far, and keep whichever answers first. pN starts after 20\n"
+            "                            requests, with several URLs or in kxh shell, unless it has a\n"
+            "                            delay to use until then, e.g. p95,200ms\n"
+            "  --retries [count]         Retry connection errors, timeouts and --retry-on statuses.\n"
+            "                            POST and PATCH are only retried if nothing was sent yet,\n"
+            "                            or on a 429 or 503 that carries Retry-After\n"
+            "  --retry-on [statuses]     Statuses to retry, e.g. 429,502-504 (default 429,503)\n"
+            "  --retry-backoff [delay]   First backoff, doubled per retry with full jitter (default 100ms)\n"
+            "  --retry-max-backoff [d]   Backoff ceiling (default 10s), Retry-After is honored when sent\n"
+            "  --retry-budget [percent]  Retries allowed across all requests, beyond the first 10 (default 20)\n\n"
+            "Connection Options:\n"
+            "  --unix-socket [path]      Connect through a Unix domain socket, the URL still sets Host and path\n"
+            "  --read-buffer [size]      Read buffer size (default 4K, e.g., --read-buffer 256K)\n"
+            "  --adaptive-read           Grow the read buffer and SO_RCVBUF during bulk transfers\n"
+            "  --no-tcp-nodelay          Let Nagle's algorithm batch small writes (TCP_NODELAY is on by default)\n"
+            "  --tcp-fastopen            Send the first request bytes in the SYN (TCP Fast Open)\n"
+            "  --quickack                Disable delayed ACKs (TCP_QUICKACK)\n"
+            "  --busy-poll [usec]        Busy poll the device queue while reading (SO_BUSY_POLL)\n"
+            "  --sndbuf [size]           Socket send buffer size (SO_SNDBUF, e.g., --sndbuf 1M)\n"
+            "  --rcvbuf [size]           Socket receive buffer size (SO_RCVBUF, e.g., --rcvbuf 4M)\n"
+            "  --connect-timeout [d]     Connect timeout (default 300s)\n"
+            "  --read-timeout [d]        Longest wait for each read (default 5s)\n"
+            "  --write-timeout [d]       Longest wait for each write (default 5s)\n"
+            "  --tls-timeout [d]         Whole TLS handshake (default 10s)\n"
+            "  --max-time [d]            Deadline for a request, from connect to last byte, retries included\n\n"
+            "Bench Options:\n"
+            "  -n, --requests [count]    Total number of requests to send (default 1000)\n"
+            "  --concurrency [count]     Number of parallel connections (default 10)\n"
+            "  --scenario [file]         Run a weighted mix of requests instead of a single URL\n"
+            "  --stages [profile]        Send at a set rate instead of a count, e.g. 100:30s,2000:60s,2000:30s\n"
+            "                            holds 100 req/s for 30s, ramps to 2000 over 60s and holds it 30s\n"
+            "  --ramp [rate:duration]    Climb from 0 req/s first, e.g. --ramp 500:10s --stages 500:60s\n"
+            "                            --concurrency caps the requests in flight during a staged run\n"
+            "  --find-max --slo [slo]    Find the highest rate that keeps an SLO, e.g. --slo p99<50ms\n"
+            "                            doubles the rate from --start-rate (default 10) until a probe\n"
+            "                            breaks it, then bisects. A probe also fails above 1% errors\n"
+            "  --probe [duration]        How long each rate is held (default 10s)\n"
+            "  {{seq}} and {{rand}} in the URL, headers or body are filled in per request\n\n"
+            "Scenario Files:\n"
+            "  One request per line in kxh syntax, # starts a comment, e.g.\n"
+            "    GET https://api.example.com/items/{{rand}} --weight 70\n"
+            "    POST https://api.example.com/orders -j '{\"id\": {{seq}}}' --weight 20 --think 100ms\n"
+            "    DELETE https://api.example.com/items/{{seq}} --weight 10\n"
+            "    GET https://api.example.com/health --concurrency 2 --name health\n"
+            "  --weight picks the share among the bench's workers, --concurrency gives a line\n"
+            "  its own workers instead, --think pauses after each request. Every line gets\n"
+            "  its own latency percentiles in the report. Headers and cookies given to bench\n"
+            "  are sent along with each line's own.\n\n"
+            "Shell:\n"
+            "  kxh shell reads one request per line, e.g. GET /users or POST /items -j '{\"a\": 1}',\n"
+            "  against the base URL over kept-alive connections. Headers, cookies and auth given\n"
+            "  to kxh shell apply to every line, a line's own -H replaces a header of the same name.\n"
+            "  Quote values with spaces, type exit or quit (or end the input) to leave.\n\n"
+            "Daemon:\n"
+            "  kxh daemon keeps connections, TLS sessions and resolved addresses warm. While it\n"
+            "  runs, plain requests are handed to it over a Unix socket ($KXH_DAEMON_SOCKET,\n"
+            "  $XDG_RUNTIME_DIR/kxh.sock or /tmp/kxh-<uid>.sock). It uses its own environment,\n"
+            "  e.g. SSL_CERT_FILE, so restart it after changing those.\n"
+            "  --socket [path]           Socket to listen on\n\n"
+            "Distributed Bench:\n"
+            "  kxh agent runs bench jobs for a coordinator, one at a time, and sends back its\n"
+            "  latency histograms, which the coordinator merges into one report. The token is\n"
+            "  sent in the clear, keep agents on a trusted network.\n"
+            "  --listen [address]        Address to listen on (default :7879)\n"
+            "  --token [secret]          Required secret, or $KXH_AGENT_TOKEN\n"
+            "  kxh bench ... --agents a:7879,b:7879 splits -n, or each stage's rate, and --max-rps\n"
+            "  between the agents and starts them together. --concurrency applies per agent, and\n"
+            "  file paths in the request must exist on the agents.\n"
+            "  --agent-token [secret]    Token the agents expect, or $KXH_AGENT_TOKEN\n\n"
             "Example Usage:\n"
             "  kxh GET https://api.example.com -o response.txt\n"
-            "  kxh POST https://api.example.com -j {\"name\": \"John\"}\n";
+            "  kxh GET https://a.example.com/health https://b.example.com/health --parallel 4\n"
+            "  kxh GET - < urls.txt\n"
+            "  kxh POST https://api.example.com -j {\"name\": \"John\"}\n"
+            "  kxh bench GET https://api.example.com/items/{{seq}} -n 10000 --concurrency 32\n";
+
+    auto showHelp = [&customHelpMessage]() {
+        std::cout << customHelpMessage << std::endl;
+        exit(0);
+    };
 
     app.set_version_flag("-v, --version", KXHTTP_VER);
-    app.add_option("HTTP Method", methodStr, "HTTP method (GET, POST,...)")->required();
-    app.add_option("URL", request.url, "URL to send the request to")->required();
-    app.add_option("-f,--form", request.formData, "Send form data");
-    app.add_option("--form-file", request.formFiles, "Form file uploads");
-    app.add_option("-j,--json", request.jsonData, "Send raw JSON data");
-    app.add_option("--json-file", request.jsonFile, "Upload a JSON file");
-    app.add_option("-H,--headers", request.headers, "Send custom headers");
-    app.add_option("-c,--cookies", request.cookies, "Send custom cookies");
-    app.add_option("-a,--auth", request.authData, "Basic Authentication");
-    app.add_option("--auth-digest", request.authDigest, "Digest Authentication");
-    app.add_option("--auth-token", request.authBearerToken, "Bearer Token Authentication");
+    KxHTTP::addRequestTarget(&app, request, methodStr);
+    KxHTTP::addRequestOptions(&app, request);
+    std::vector<std::string> moreUrls;
+    unsigned parallel = 8;
+    app.add_option("More URLs", moreUrls, "Further URLs to send the same request to, - reads them from stdin");
     app.add_option("-o,--output", request.outputFile, "Save output to a file");
+    const std::map<std::string, KxHTTP::OutputFormat> formats{
+            { "text", KxHTTP::OUTPUT_TEXT }, { "json", KxHTTP::OUTPUT_JSON }, { "jsonl", KxHTTP::OUTPUT_JSONL } };
+    app.add_option("--format", request.format, "Output format: text, json or jsonl")
+            ->transform(CLI::CheckedTransformer(formats));
+    app.add_flag("-s,--silent,--summary", request.summary, "Print status, size and timing, count the body without keeping it");
+    app.add_option("--parallel", parallel, "Requests in flight at once with several URLs")
+            ->check(CLI::PositiveNumber);
+    bool unordered = false;
+    app.add_flag("--unordered", unordered, "Print results from several URLs as they finish");
+    bool noDaemon = false;
+    app.add_flag("--no-daemon", noDaemon, "Do not hand the request to a running daemon");
+    std::vector<std::string> maxRps;
+    app.add_option("--max-rps", maxRps, "Cap requests per second to a host, HOST=RATE[:BURST]");
+    std::string hedgeAfter;
+    app.add_option("--hedge-after", hedgeAfter, "Duplicate a slow GET or HEAD after a delay or a percentile (p95)");
+
+    KxHTTP::RetryOptions retryOptions;
+    std::string retryStatuses;
+    double retryBudgetPercent = 20;
+    auto addRetryOptions = [&](CLI::App *target) {
+        target->add_option("--retries", retryOptions.retries, "Retries after a failed attempt");
+        target->add_option("--retry-on", retryStatuses, "Statuses worth retrying (default 429,503)");
+        target->add_option("--retry-backoff", retryOptions.baseMs, "First backoff, doubled per retry")
+                ->transform(KxHTTP::durationTransformer())->check(CLI::Range(0.0, double(INT32_MAX)));
+        target->add_option("--retry-max-backoff", retryOptions.capMs, "Backoff ceiling")
+                ->transform(KxHTTP::durationTransformer())->check(CLI::Range(0.0, double(INT32_MAX)));
+        target->add_option("--retry-budget", retryBudgetPercent, "Retries allowed as a percentage of requests")
+                ->check(CLI::Range(0.0, 100.0));
+    };
+    addRetryOptions(&app);
+
+    auto *bench = app.add_subcommand("bench", "Benchmark a request");
+    KxHTTP::addRequestTarget(bench, request, methodStr);
+    KxHTTP::addRequestOptions(bench, request);
+    bench->add_option("-n,--requests", benchOptions.requests, "Total number of requests to send");
+    bench->add_option("--max-rps", maxRps, "Cap requests per second to a host, HOST=RATE[:BURST]");
+    bench->add_option("--concurrency", benchOptions.concurrency, "Number of parallel connections");
+    std::string scenarioFile;
+    bench->add_option("--scenario", scenarioFile, "Weighted mix of requests, one per line");
+    std::string ramp;
+    std::string stages;
+    bench->add_option("--ramp", ramp, "Climb from 0 to RATE:DURATION before any stages");
+    bench->add_option("--stages", stages, "Load profile as RATE:DURATION,...");
+    bool findMax = false;
+    std::string slo;
+    KxHTTP::FindMaxOptions findMaxOptions;
+    bench->add_flag("--find-max", findMax, "Search for the highest rate that meets --slo");
+    bench->add_option("--slo", slo, "Latency objective for --find-max, e.g. p99<50ms");
+    bench->add_option("--start-rate", findMaxOptions.startRate, "First rate --find-max probes");
+    double probeMs = 10000;
+    bench->add_option("--probe", probeMs, "How long each --find-max rate is held")->transform(KxHTTP::durationTransformer());
+    std::vector<std::string> agents;
+    const char *envToken = std::getenv("KXH_AGENT_TOKEN");
+    std::string agentToken = envToken != nullptr ? envToken : "";
+    bench->add_option("--agents", agents, "Run the bench on these kxh agents (host[:port],...)")->delimiter(',');
+    bench->add_option("--agent-token", agentToken, "Token the agents were started with");
+
+    std::string shellBaseUrl;
+    auto *shell = app.add_subcommand("shell", "Send requests interactively over kept-alive connections");
+    shell->add_option("Base URL", shellBaseUrl, "URL the request paths are relative to")->required();
+    KxHTTP::addRequestOptions(shell, request);
+    shell->add_option("--max-rps", maxRps, "Cap requests per second to a host, HOST=RATE[:BURST]");
+    shell->add_option("--hedge-after", hedgeAfter, "Duplicate a slow GET or HEAD after a delay or a percentile (p95)");
+    addRetryOptions(shell);
+    shell->add_option("--format", request.format, "Output format: text, json or jsonl")
+            ->transform(CLI::CheckedTransformer(formats));
+    shell->add_flag("-s,--silent,--summary", request.summary, "Print status, size and timing, count the body without keeping it");
+
+    std::string daemonSocket = KxHTTP::daemonSocketPath();
+    auto *daemon = app.add_subcommand("daemon", "Serve requests from other kxh invocations");
+    daemon->add_option("--socket", daemonSocket, "Unix socket to listen on");
+
+    std::string agentAddress = ":" + std::to_string(KXHTTP_AGENT_PORT);
+    auto *agent = app.add_subcommand("agent", "Run bench jobs for a coordinator");
+    agent->add_option("--listen", agentAddress, "Address to accept coordinators on");
+    agent->add_option("--token", agentToken, "Secret coordinators must present");
 
     // Overriding CLI11's help message
     app.set_help_flag();
-    app.add_flag_callback("-h,--help", [&customHelpMessage]() {
-        std::cout << customHelpMessage << std::endl;
-        exit(0);
-    }, "Show help message");
+    app.add_flag_callback("-h,--help", showHelp, "Show help message");
+    bench->set_help_flag();
+    bench->add_flag_callback("-h,--help", showHelp, "Show help message");
+    shell->set_help_flag();
+    shell->add_flag_callback("-h,--help", showHelp, "Show help message");
+    daemon->set_help_flag();
+    daemon->add_flag_callback("-h,--help", showHelp, "Show help message");
+    agent->set_help_flag();
+    agent->add_flag_callback("-h,--help", showHelp, "Show help message");
 
     try {
         CLI11_PARSE(app, argc, argv);
-        request.method = KxHTTP::stringToMethod(methodStr);
+        if (!daemon->parsed() && !shell->parsed() && !agent->parsed() && scenarioFile.empty()) {
+            if (methodStr.empty() || request.url.empty())
+                throw std::runtime_error("HTTP Method and URL are required, see kxh --help");
+            request.method = KxHTTP::stringToMethod(methodStr);
+        }
     } catch (const CLI::ParseError &e) {
         std::cerr << KXHTTP_CONSOLE_RED << "Parsing Error: " << e.what() << KXHTTP_CONSOLE_RESET;
+        return 1;
     } catch (const std::exception &e) {
         std::cerr << KXHTTP_CONSOLE_RED << "Fatal Error: " << e.what() << KXHTTP_CONSOLE_RESET;
+        return 1;
     }
 
+#ifndef _WIN32
+    // A server hanging up mid-write should surface as an error, not kill us
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
     try {
-        KxHTTP::HTTPRequest rq(request);
-        rq.sendRequest();
-        rq.processResponse();
+        for (const auto& limit : maxRps)
+            KxHTTP::hostRateLimiter().addLimit(limit);
+        if (!hedgeAfter.empty())
+            KxHTTP::hedgePolicy().configure(hedgeAfter);
+        if (!retryStatuses.empty())
+            retryOptions.statuses = KxHTTP::parseStatusList(retryStatuses);
+        retryOptions.budget = retryBudgetPercent / 100;
+        KxHTTP::retryPolicy().configure(retryOptions);
+
+        if (!ramp.empty() || !stages.empty()) {
+            if (!ramp.empty()) {
+                benchOptions.stages = KxHTTP::parseStages(ramp);
+                if (benchOptions.stages.size() != 1)
+                    throw std::runtime_error("--ramp takes a single RATE:DURATION");
+                benchOptions.rampFromZero = true;
+            }
+            if (!stages.empty()) {
+                auto profile = KxHTTP::parseStages(stages);
+                benchOptions.stages.insert(benchOptions.stages.end(), profile.begin(), profile.end());
+            }
+        }
+
+        if (daemon->parsed()) {
+            KxHTTP::Daemon server(daemonSocket);
+            server.run();
+            return 0;
+        }
+
+        if (agent->parsed()) {
+            KxHTTP::BenchAgent worker(agentAddress, agentToken);
+            worker.run();
+            return 0;
+        }
+
+        if (shell->parsed()) {
+            KxHTTP::Shell repl(shellBaseUrl, std::move(request));
+            repl.run(std::cin);
+            return 0;
+        }
+
+        // Several URLs (or - for a list on stdin) are fanned out from here
+        std::vector<std::string> urls;
+        bool fanOutMode = !bench->parsed() && (!moreUrls.empty() || request.url == "-");
+        if (fanOutMode) {
+            moreUrls.insert(moreUrls.begin(), request.url);
+            for (const auto& url : moreUrls) {
+                if (url != "-") {
+                    urls.push_back(url);
+                    continue;
+                }
+                std::string line;
+                while (std::getline(std::cin, line)) {
+                    auto first = line.find_first_not_of(" \t\r");
+                    auto last = line.find_last_not_of(" \t\r");
+                    if (first != std::string::npos && line[first] != '#')
+                        urls.push_back(line.substr(first, last - first + 1));
+                }
+            }
+        }
+        if (fanOutMode) {
+            KxHTTP::FanOut fanOut(std::move(request), std::move(urls), parallel, !unordered);
+            fanOut.run(std::cout);
+            return 0;
+        }
+
+        // A single request never sees the samples a bare percentile waits for
+        if (!bench->parsed() && KxHTTP::hedgePolicy().needsSamples())
+            throw std::runtime_error("--hedge-after " + hedgeAfter + " needs " + std::to_string(KXHTTP_HEDGE_MIN_SAMPLES)
+                                     + " earlier requests, give a delay to use until then, e.g. "
+                                     + hedgeAfter + ",200ms");
+
+        // A running daemon already has warm connections, let it do the work.
+        // -o files are written by this process, so those requests stay here.
+        std::string forwardError;
+        if (!bench->parsed() && !noDaemon && maxRps.empty() && hedgeAfter.empty() && retryOptions.retries == 0
+            && request.format == KxHTTP::OUTPUT_TEXT && !request.summary && request.outputFile.empty()
+            && KxHTTP::forwardToDaemon(request, std::cout, forwardError)) {
+            if (!forwardError.empty())
+                std::cerr << KXHTTP_CONSOLE_RED << "Error: " << forwardError << KXHTTP_CONSOLE_RESET;
+            return 0;
+        }
+
+        if (findMax && slo.empty())
+            throw std::runtime_error("--find-max needs an --slo, e.g. --slo p99<50ms");
+        findMaxOptions.probeSeconds = probeMs / 1000.0;
+
+        if (bench->parsed() && !agents.empty()) {
+            if (findMax)
+                throw std::runtime_error("--find-max runs locally, it cannot be combined with --agents");
+
+            std::string scenarioText;
+            if (!scenarioFile.empty()) {
+                std::ifstream file(scenarioFile);
+                if (!file)
+                    throw std::runtime_error("Failed to open scenario file: " + scenarioFile);
+                scenarioText.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+                if (scenarioText.empty())
+                    throw std::runtime_error("Scenario file has no requests: " + scenarioFile);
+            }
+            KxHTTP::runOnAgents(agents, agentToken, request, scenarioText, benchOptions);
+            return 0;
+        }
+
+        if (bench->parsed() && !scenarioFile.empty()) {
+            auto scenarios = KxHTTP::loadScenarios(scenarioFile, request);
+            if (findMax) {
+                findMaxOptions.slo = KxHTTP::parseSlo(slo);
+                KxHTTP::findMaxRate(scenarios, benchOptions, findMaxOptions);
+                return 0;
+            }
+            KxHTTP::Bench runner(std::move(scenarios), benchOptions);
+            runner.run();
+            runner.printReport();
+            return 0;
+        }
+
+        KxHTTP::OutputFormat format = request.format;
+        KxHTTP::HTTPRequest rq(std::move(request));
+
+        if (bench->parsed()) {
+            // The request is serialized once and replayed by every worker
+            KxHTTP::RequestTemplate tpl = rq.compile();
+            if (findMax) {
+                findMaxOptions.slo = KxHTTP::parseSlo(slo);
+                KxHTTP::findMaxRate({ { std::string(), tpl } }, benchOptions, findMaxOptions);
+                return 0;
+            }
+            KxHTTP::Bench runner(tpl, benchOptions);
+            runner.run();
+            runner.printReport();
+            return 0;
+        }
+
+        try {
+            rq.sendRequest();
+        } catch (const std::runtime_error& e) {
+            // Structured output reports a failed request as a record too
+            if (format == KxHTTP::OUTPUT_TEXT)
+                throw;
+            rq.processError(std::cout, e.what());
+            return 0;
+        }
+        rq.processResponse(std::cout);
     } catch(const std::exception &e) {
         std::cerr << KXHTTP_CONSOLE_RED << "Error: " << e.what() << KXHTTP_CONSOLE_RESET;
     }
@@ -76,11 +460,27 @@ int main(int argc, char ** argv)
 // HTTPRequest Class Implementations
 //
 
-KxHTTP::HTTPRequest::HTTPRequest(KxHTTP::RequestData& rd)
+KxHTTP::HTTPRequest::HTTPRequest(KxHTTP::RequestData&& rd)
 {
-    this->requestData = rd;
+    this->requestData = std::move(rd);
     this->fileOutputStatus = false;
-    this->authTypeDefined = false;
+    this->requestSent = false;
+    this->hedged = false;
+    this->pool = nullptr;
+    this->deadline = Connection::Deadline::max();
+    this->attempts = 0;
+    this->bodyBytes = 0;
+    this->payloadReady = false;
+}
+
+KxHTTP::HTTPRequest::HTTPRequest(const KxHTTP::HTTPRequest& prototype, const std::string& url)
+    : HTTPRequest(RequestData(prototype.requestData))
+{
+    // The prototype's payload options were dropped once built, so this copies
+    // little more than the URL; body parts are shared, not duplicated
+    this->requestData.url = url;
+    this->outgoing = prototype.outgoing;
+    this->payloadReady = prototype.payloadReady;
 }
 
 void KxHTTP::HTTPRequest::sendRequest()
@@ -89,94 +489,239 @@ void KxHTTP::HTTPRequest::sendRequest()
     // Send request, print errors if any
     // Then, processResponse() handles the output for that request
 
-    auto *cli = new httplib::Client(KxHTTP::getProtocolAndDomain(this->requestData.url));
+    this->prepare();
+
+    this->withRetries([this]() {
+        auto conn = std::make_unique<Connection>(this->endpoint, this->deadline);
+        this->exchange(conn);
+    });
+}
+
+void KxHTTP::HTTPRequest::sendRequest(ConnectionPool& pool)
+{
+    this->prepare();
+
+    this->pool = &pool;
+    this->withRetries([this, &pool]() {
+        bool reused = false;
+        auto conn = pool.acquire(this->endpoint, reused, this->deadline);
+        uint64_t received = conn->bytesReceived();
+        try {
+            this->exchange(conn);
+        } catch (const std::runtime_error&) {
+            // A pooled connection the server had already dropped is closed or reset
+            // under us before a single response byte, that one is sent again once on
+            // a fresh connection. A timeout is not: the server may have the request.
+            // Once a hedge went out, conn may be the duplicate, whose counters say
+            // nothing about the pooled connection, so nothing is sent again then.
+            bool stale = !this->hedged && conn->peerDropped() && conn->bytesReceived() == received;
+            if (!reused || !stale || (this->requestSent && !this->isIdempotent()))
+                throw;
+            conn->reconnect();
+            this->digestAuthorization.clear();
+            this->exchange(conn);
+        }
+
+        if (this->response.keepAlive)
+            pool.release(std::move(conn));
+    });
+}
+
+bool KxHTTP::HTTPRequest::isIdempotent() const
+{
+    return this->requestData.method != HTTP_POST && this->requestData.method != HTTP_PATCH;
+}
+
+void KxHTTP::HTTPRequest::withRetries(const std::function<void()>& attempt)
+{
+    RetryPolicy& policy = retryPolicy();
+    policy.recordRequest();
+    bool idempotent = this->isIdempotent();
+
+    // --max-time covers retries and their backoff too, not just one attempt
+    auto started = std::chrono::steady_clock::now();
+    int deadlineMs = this->endpoint.options.deadlineMs;
+    if (deadlineMs > 0)
+        this->deadline = started + std::chrono::milliseconds(deadlineMs);
+    auto elapsed = [started]() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - started).count());
+    };
+
+    for (unsigned retry = 1;; retry++) {
+        std::exception_ptr error;
+        std::string reason;
+        try {
+            this->requestSent = false;
+            this->hedged = false;
+            this->digestAuthorization.clear();
+            this->fileOutputStatus = false;
+            this->response = Response();
+            this->timing = ResponseTiming();
+            this->bodyBytes = 0;
+            this->attempts = retry;
+            attempt();
+            this->timing.total = elapsed();
+            if (!policy.retryStatus(this->response.status))
+                return;
+            // A POST or PATCH that got an answer was processed, unless the server
+            // explicitly asked for it again later with a 429 or 503 and Retry-After
+            bool askedAgain = (this->response.status == 429 || this->response.status == 503)
+                              && this->response.headers.has("Retry-After");
+            if (!idempotent && !askedAgain)
+                return;
+            reason = "status " + std::to_string(this->response.status);
+        } catch (const std::runtime_error& e) {
+            this->timing.total = elapsed();
+            // Once it reached the server, only an idempotent request may be sent again
+            if (this->requestSent && !idempotent)
+                throw;
+            error = std::current_exception();
+            reason = e.what();
+        }
+
+        // Out of attempts or budget: the last error, or the last response, is what the caller gets
+        if (retry > policy.maxRetries() || !policy.takeRetry()) {
+            if (error)
+                std::rethrow_exception(error);
+            return;
+        }
+
+        double delay = policy.delayMs(retry, error ? std::string_view() : this->response.headers.get("Retry-After"));
+        if (std::chrono::steady_clock::now() + std::chrono::duration<double, std::milli>(delay) >= this->deadline) {
+            if (error)
+                std::rethrow_exception(error);
+            return;
+        }
+
+        // One write, so notes from concurrent requests do not interleave. JSON and
+        // summary output stay one line per request and report the attempt count instead.
+        if (this->requestData.format == OUTPUT_TEXT && !this->requestData.summary) {
+            std::ostringstream note;
+            note << KXHTTP_CONSOLE_YELLOW << "Retrying " << this->requestData.url << " in "
+                 << static_cast<long>(delay) << "ms (" << reason << ")" << KXHTTP_CONSOLE_RESET << "\n";
+            std::cerr << note.str() << std::flush;
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(delay));
+    }
+}
+
+KxHTTP::RequestTemplate KxHTTP::HTTPRequest::compile()
+{
+    // Templates are replayed verbatim, there is no room for a Digest challenge
+    if (!this->requestData.authDigest.empty() && this->requestData.authData.empty())
+        throw std::runtime_error("Digest Authentication is not supported for repeated requests");
+
+    this->prepare();
+    return RequestTemplate(this->endpoint, this->outgoing);
+}
+
+void KxHTTP::HTTPRequest::prepare()
+{
+    if (!this->payloadReady)
+        this->preparePayload();
+
+    Url url = KxHTTP::parseRequestUrl(this->requestData.url);
+    this->endpoint = KxHTTP::endpointFromUrl(url);
+    this->endpoint.unixSocket = this->requestData.unixSocket;
+    this->endpoint.options = this->requestData.connection;
+    this->outgoing.path = url.requestTarget();
+
+    // Credentials embedded in the URL are used when no auth flag was given
+    if (!url.userinfo.empty() && this->requestData.authData.empty() && this->requestData.authDigest.empty()
+        && this->requestData.authBearerToken.empty() && !this->outgoing.headers.has("Authorization"))
+    {
+        std::string userinfo = httplib::detail::decode_url(std::string(url.userinfo), false);
+        auto colonPos = userinfo.find(':');
+        auto header = httplib::make_basic_authentication_header(userinfo.substr(0, colonPos),
+                colonPos == std::string::npos ? std::string() : userinfo.substr(colonPos + 1));
+        this->outgoing.headers.add(header.first, header.second);
+    }
+}
+
+void KxHTTP::HTTPRequest::preparePayload()
+{
+    this->outgoing.method = KxHTTP::methodToString(this->requestData.method);
+    this->outgoing.headers = constructHeaders();
+    this->outgoing.body = Body();
+    setAuth(this->outgoing.headers);
 
     switch (this->requestData.method)
     {
-        case HTTP_GET:
-            this->sendGET(cli);
-            break;
         case HTTP_POST:
-            this->sendPOST(cli);
+            this->preparePOST();
             break;
         case HTTP_PUT:
-            this->sendPUT(cli);
-            break;
-        case HTTP_DELETE:
-            this->sendDELETE(cli);
+            this->preparePUT();
             break;
         case HTTP_PATCH:
-            this->sendPATCH(cli);
+            this->preparePATCH();
             break;
+        case HTTP_GET:
+        case HTTP_DELETE:
         case HTTP_OPTIONS:
-            this->sendOPTIONS(cli);
-            break;
         case HTTP_HEAD:
-            this->sendHEAD(cli);
+            // Bodyless methods, nothing to add
             break;
     }
 
-    delete cli;
+    // Everything now lives in outgoing, the options it was built from are
+    // dropped so copies made for other URLs stay cheap
+    this->requestData.formData.clear();
+    this->requestData.formFiles.clear();
+    this->requestData.jsonData.clear();
+    this->requestData.jsonFile.clear();
+    this->requestData.dataBinary.clear();
+    this->requestData.headers.clear();
+    this->requestData.cookies.clear();
+    this->jsonBody = Body();
+    this->payloadReady = true;
 }
 
-void KxHTTP::HTTPRequest::sendGET(httplib::Client *cli)
+void KxHTTP::HTTPRequest::preparePOST()
 {
-    httplib::Headers headers = constructHeaders();
-    setAuth(cli);
-
-    this->result = cli->Get(getPathFromUrl(this->requestData.url), headers);
-    this->handleFileOutput();
-}
-
-void KxHTTP::HTTPRequest::sendPOST(httplib::Client *cli)
-{
-    httplib::Headers headers = constructHeaders();
-    setAuth(cli);
-    std::string path = getPathFromUrl(this->requestData.url);
-
     // Handle JSON data or JSON file upload
     // Prioritizes JSON flags over form data flags
 
     if (!this->requestData.jsonData.empty()) {
-        headers.emplace("Content-Type", "application/json");
-        std::string jsonBody = this->requestData.jsonData[0];
-        this->result = cli->Post(path, headers, jsonBody, "application/json");
+        this->setBody(this->jsonPayload(), "application/json");
     } else if (!this->requestData.jsonFile.empty()) {
-        std::ifstream jsonFile(this->requestData.jsonFile);
-        if (jsonFile) {
-            std::string jsonContent((std::istreambuf_iterator<char>(jsonFile)), std::istreambuf_iterator<char>());
-            headers.emplace("Content-Type", "application/json");
-            this->result = cli->Post(path, headers, jsonContent, "application/json");
-        } else {
+        // Sent straight from the file, with sendfile() on plain HTTP
+        Body body;
+        try {
+            body.appendFile(std::make_shared<const MappedFile>(this->requestData.jsonFile));
+        } catch (const std::runtime_error&) {
             throw std::runtime_error("Failed to open JSON file: " + this->requestData.jsonFile);
         }
+        this->setBody(std::move(body), "application/json");
+    } else if (!this->requestData.dataBinary.empty()) {
+        this->setBody(this->binaryPayload(), "application/octet-stream");
     }
 
     // Multipart/form-data POST request (files and/or form data)
+    // Boundaries and part headers go into small buffers, file contents are
+    // mapped and written to the socket straight from the page cache.
     else
     {
-        httplib::MultipartFormDataItems items;
+        std::string boundary = httplib::detail::make_multipart_data_boundary();
+        Body body;
 
         // Add form files to multipart form data
         for (const auto& formFile : this->requestData.formFiles) {
             auto delimiterPos = formFile.find('=');
             if (delimiterPos != std::string::npos) {
-                std::string key = formFile.substr(0, delimiterPos);
                 std::string filePath = formFile.substr(delimiterPos + 1);
-                // Open file and read content
-                std::ifstream file(filePath, std::ios::binary);
-                if (!file) {
-                    throw std::runtime_error("File '" + filePath + "' not found!");
-                }
+                auto file = std::make_shared<const MappedFile>(filePath);
 
-                else
-                {
-                    std::string fileContent((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-                    std::string filename = filePath.substr(filePath.find_last_of("/\\") + 1);
-                    // Determine MIME type based on file extension (basic implementation)
-                    std::string mimeType = "application/octet-stream"; // default MIME type
-                    items.push_back({ key, fileContent, filename, mimeType });
-                }
+                httplib::MultipartFormData item;
+                item.name = formFile.substr(0, delimiterPos);
+                item.filename = filePath.substr(filePath.find_last_of("/\\") + 1);
+                // Determine MIME type based on file extension (basic implementation)
+                item.content_type = "application/octet-stream"; // default MIME type
+
+                body.append(httplib::detail::serialize_multipart_formdata_item_begin(item, boundary));
+                body.appendFile(std::move(file));
+                body.append(httplib::detail::serialize_multipart_formdata_item_end());
             }
         }
 
@@ -184,34 +729,34 @@ void KxHTTP::HTTPRequest::sendPOST(httplib::Client *cli)
         for (const auto& data : this->requestData.formData) {
             auto delimiterPos = data.find('=');
             if (delimiterPos != std::string::npos) {
-                std::string key = data.substr(0, delimiterPos);
-                std::string value = data.substr(delimiterPos + 1);
-                items.push_back({ key, value, "", "" });
+                httplib::MultipartFormData item;
+                item.name = data.substr(0, delimiterPos);
+
+                body.append(httplib::detail::serialize_multipart_formdata_item_begin(item, boundary));
+                body.append(data.substr(delimiterPos + 1));
+                body.append(httplib::detail::serialize_multipart_formdata_item_end());
             }
         }
 
         // If there are items to send
-        if (!items.empty()) {
-            this->result = cli->Post(path, headers, items);
+        if (!body.empty()) {
+            body.append(httplib::detail::serialize_multipart_formdata_finish(boundary));
+            this->setBody(std::move(body), httplib::detail::serialize_multipart_formdata_get_content_type(boundary));
         } else {
             // Simple POST request with no Body
-            this->result = cli->Post(path, headers, "", "text/plain");
+            this->setBody(Body(), "text/plain");
         }
     }
-
-    this->handleFileOutput();
 }
 
-void KxHTTP::HTTPRequest::sendPUT(httplib::Client *cli)
+void KxHTTP::HTTPRequest::preparePUT()
 {
-    httplib::Headers headers = constructHeaders();
-    setAuth(cli);
-    std::string path = getPathFromUrl(this->requestData.url);
-
     if (!this->requestData.jsonData.empty()) {
-        headers.emplace("Content-Type", "application/json");
-        std::string jsonBody = this->requestData.jsonData[0];
-        this->result = cli->Put(path, headers, jsonBody, "application/json");
+        this->setBody(this->jsonPayload(), "application/json");
+    }
+
+    else if (!this->requestData.dataBinary.empty()) {
+        this->setBody(this->binaryPayload(), "application/octet-stream");
     }
 
     else if (!this->requestData.formData.empty()) {
@@ -222,36 +767,21 @@ void KxHTTP::HTTPRequest::sendPUT(httplib::Client *cli)
             }
             formBody += data;
         }
-        headers.emplace("Content-Type", "application/x-www-form-urlencoded");
-        this->result = cli->Put(path, headers, formBody, "application/x-www-form-urlencoded");
+        this->setBody(Body(std::move(formBody)), "application/x-www-form-urlencoded");
     }
 
     else
-        this->result = cli->Put(path, headers, "", "text/plain");
-
-    handleFileOutput();
-}
-
-void KxHTTP::HTTPRequest::sendDELETE(httplib::Client *cli)
-{
-    httplib::Headers headers = constructHeaders();
-    setAuth(cli);
-    std::string path = getPathFromUrl(this->requestData.url);
-
-    this->result = cli->Delete(path, headers);
-    this->handleFileOutput();
+        this->setBody(Body(), "text/plain");
 }
 
-void KxHTTP::HTTPRequest::sendPATCH(httplib::Client *cli)
+void KxHTTP::HTTPRequest::preparePATCH()
 {
-    httplib::Headers headers = constructHeaders();
-    setAuth(cli);
-    std::string path = getPathFromUrl(this->requestData.url);
-
     if (!this->requestData.jsonData.empty()) {
-        headers.emplace("Content-Type", "application/json");
-        std::string jsonBody = this->requestData.jsonData[0];
-        this->result = cli->Patch(path, headers, jsonBody, "application/json");
+        this->setBody(this->jsonPayload(), "application/json");
+    }
+
+    else if (!this->requestData.dataBinary.empty()) {
+        this->setBody(this->binaryPayload(), "application/octet-stream");
     }
 
     else if (!this->requestData.formData.empty()) {
@@ -262,54 +792,115 @@ void KxHTTP::HTTPRequest::sendPATCH(httplib::Client *cli)
             }
             formBody += data;
         }
-        headers.emplace("Content-Type", "application/x-www-form-urlencoded");
-        this->result = cli->Patch(path, headers, formBody, "application/x-www-form-urlencoded");
+        this->setBody(Body(std::move(formBody)), "application/x-www-form-urlencoded");
     }
 
     else {
-        this->result = cli->Patch(path, headers, "", "text/plain");
+        this->setBody(Body(), "text/plain");
     }
+}
 
-    handleFileOutput();
+const KxHTTP::Body& KxHTTP::HTTPRequest::jsonPayload()
+{
+    // The JSON is moved out of requestData on first use and shared from then on
+    if (this->jsonBody.empty() && !this->requestData.jsonData.empty())
+        this->jsonBody = Body(std::move(this->requestData.jsonData[0]));
+    return this->jsonBody;
 }
 
-void KxHTTP::HTTPRequest::sendOPTIONS(httplib::Client *cli)
+KxHTTP::Body KxHTTP::HTTPRequest::binaryPayload()
 {
-    httplib::Headers headers = constructHeaders();
-    setAuth(cli);
-    std::string path = getPathFromUrl(this->requestData.url);
+    // --data-binary @path uploads the file as-is, anything else is sent literally
+    if (this->requestData.dataBinary[0] != '@')
+        return Body(this->requestData.dataBinary);
 
-    this->result = cli->Options(path, headers);
-    handleFileOutput();
+    Body body;
+    body.appendFile(std::make_shared<const MappedFile>(this->requestData.dataBinary.substr(1)));
+    return body;
 }
 
-void KxHTTP::HTTPRequest::sendHEAD(httplib::Client *cli)
+void KxHTTP::HTTPRequest::setBody(Body body, std::string_view contentType)
 {
-    httplib::Headers headers = constructHeaders();
-    setAuth(cli);
-    std::string path = getPathFromUrl(this->requestData.url);
-
-    this->result = cli->Head(path, headers);
-    handleFileOutput();
+    this->outgoing.body = std::move(body);
+    if (!this->outgoing.headers.has("Content-Type"))
+        this->outgoing.headers.add("Content-Type", contentType);
 }
 
-void KxHTTP::HTTPRequest::processResponse() const
+void KxHTTP::HTTPRequest::processResponse(std::ostream& out) const
 {
-    std::cout << std::flush;
-    std::cout << KXHTTP_CONSOLE_YELLOW << "Sending " << KxHTTP::methodToString(this->requestData.method) << " request to "
+    // Structured output is built whole and written once, so a record is never split
+    if (this->requestData.format != OUTPUT_TEXT) {
+        std::string json;
+        appendJsonRecord(json, this->record(), this->requestData.format);
+        out.write(json.data(), static_cast<std::streamsize>(json.size()));
+        return;
+    }
+
+    if (this->requestData.summary) {
+        this->printSummary(out);
+        return;
+    }
+
+    out << KXHTTP_CONSOLE_YELLOW << "Sending " << KxHTTP::methodToString(this->requestData.method) << " request to "
               << KXHTTP_CONSOLE_BLUE << this->requestData.url << KXHTTP_CONSOLE_RESET << "\n";
 
-    std::cout << (this->result->status == 200 ? KXHTTP_CONSOLE_GREEN : KXHTTP_CONSOLE_YELLOW) <<
-    "Request returned Status Code " << this->result->status << KXHTTP_CONSOLE_RESET << "\n";
-    std::cout << "\nHeaders: \n\n";
-    for (const auto& header : this->result->headers)
-        std::cout << header.first << ": " << header.second << "\n";
+    out << (this->response.status == 200 ? KXHTTP_CONSOLE_GREEN : KXHTTP_CONSOLE_YELLOW) <<
+    "Request returned Status Code " << this->response.status << KXHTTP_CONSOLE_RESET << "\n";
+    out << "\nHeaders: \n\n";
+    for (const auto& header : this->response.headers)
+        out << header.name << ": " << header.value << "\n";
 
-    if(this->fileOutputStatus && this->result->status == 200)
-        std::cout << KXHTTP_CONSOLE_GREEN << "\nOutput saved to: "
+    if(this->fileOutputStatus && this->response.status == 200)
+        out << KXHTTP_CONSOLE_GREEN << "\nOutput saved to: "
                   << this->requestData.outputFile << KXHTTP_CONSOLE_RESET;
     else
-        std::cout << "\nResponse Received:\n\n" << this->result->body << "\n\n";
+        out << "\nResponse Received:\n\n" << this->response.body << "\n\n";
+}
+
+void KxHTTP::HTTPRequest::printSummary(std::ostream& out) const
+{
+    auto ms = [](uint64_t micros) { return static_cast<double>(micros) / 1000; };
+
+    // One line per request, so a fan-out or shell script reads like a log
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(2);
+    line << (this->response.status == 200 ? KXHTTP_CONSOLE_GREEN : KXHTTP_CONSOLE_YELLOW) << this->response.status
+         << KXHTTP_CONSOLE_RESET << " " << KxHTTP::methodToString(this->requestData.method) << " "
+         << KXHTTP_CONSOLE_BLUE << this->requestData.url << KXHTTP_CONSOLE_RESET << " "
+         << this->bodyBytes << " bytes in " << ms(this->timing.total) << "ms (connect " << ms(this->timing.connect) << "ms";
+    if (this->timing.tls > 0)
+        line << ", tls " << ms(this->timing.tls) << "ms";
+    line << ", wait " << ms(this->timing.wait) << "ms, receive " << ms(this->timing.receive) << "ms)";
+    if (this->fileOutputStatus)
+        line << " saved to " << this->requestData.outputFile;
+    if (this->attempts > 1)
+        line << " after " << this->attempts << " attempts";
+    line << "\n";
+    out << line.str();
+}
+
+void KxHTTP::HTTPRequest::processError(std::ostream& out, const std::string& message) const
+{
+    ResultRecord failed = this->record();
+    failed.error = message;
+    std::string json;
+    appendJsonRecord(json, failed, this->requestData.format);
+    out.write(json.data(), static_cast<std::streamsize>(json.size()));
+}
+
+KxHTTP::ResultRecord KxHTTP::HTTPRequest::record() const
+{
+    ResultRecord result;
+    result.method = KxHTTP::methodToString(this->requestData.method);
+    result.url = this->requestData.url;
+    result.status = this->response.status;
+    result.headers = &this->response.headers;
+    result.bodyBytes = this->bodyBytes;
+    if (this->fileOutputStatus)
+        result.outputFile = this->requestData.outputFile;
+    result.attempts = this->attempts;
+    result.timing = this->timing;
+    return result;
 }
 
 KxHTTP::HTTPRequest::~HTTPRequest() = default;
@@ -318,48 +909,162 @@ KxHTTP::HTTPRequest::~HTTPRequest() = default;
 // Utility Functions
 //
 
-void KxHTTP::HTTPRequest::setAuth(httplib::Client *cli)
+void KxHTTP::HTTPRequest::setAuth(HeaderList& headers)
 {
-    if (!this->requestData.authData.empty() && !this->authTypeDefined)
+    // Basic and Bearer credentials go out with the first request.
+    // Digest needs the server's challenge first, see exchange().
+
+    if (!this->requestData.authData.empty())
     {
         auto colonPos = this->requestData.authData.find(':');
         if (colonPos != std::string::npos) {
-            cli->set_basic_auth(this->requestData.authData.substr(0, colonPos),
-                                this->requestData.authData.substr(colonPos + 1));
+            auto header = httplib::make_basic_authentication_header(this->requestData.authData.substr(0, colonPos),
+                                                                    this->requestData.authData.substr(colonPos + 1));
+            headers.add(header.first, header.second);
         }
+    }
 
-        this->authTypeDefined = true;
+    else if (!this->requestData.authBearerToken.empty() && this->requestData.authDigest.empty())
+    {
+        auto header = httplib::make_bearer_token_authentication_header(this->requestData.authBearerToken);
+        headers.add(header.first, header.second);
     }
+}
+
+void KxHTTP::HTTPRequest::exchange(std::unique_ptr<Connection>& conn)
+{
+    hostRateLimiter().acquire(conn->getEndpoint().host);
+
+    const Request& req = this->outgoing;
+    std::string head;
+    this->serializeHead(head, conn->getEndpoint());
+
+    auto micros = [](std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(to - from).count());
+    };
+    OpenTiming opened = conn->takeOpenTiming();
+    this->timing.connect = opened.connect;
+    this->timing.tls = opened.tls;
 
-    else if (!this->requestData.authDigest.empty() && !this->authTypeDefined)
+    // Head and body parts go out together, the body is never copied
+    auto sent = std::chrono::steady_clock::now();
+    this->requestSent = true;
+    conn->write(head, req.body);
+    auto written = std::chrono::steady_clock::now();
+    this->timing.send = micros(sent, written);
+
+    bool idempotent = this->requestData.method == HTTP_GET || this->requestData.method == HTTP_HEAD;
+    if (idempotent && hedgePolicy().enabled())
+        this->hedge(conn);
+
+    readResponseHead(*conn, this->response);
+    auto headRead = std::chrono::steady_clock::now();
+    this->timing.wait = micros(written, headRead);
+    if (idempotent && hedgePolicy().enabled())
+        hedgePolicy().record(static_cast<uint32_t>(std::min<uint64_t>(micros(sent, headRead), UINT32_MAX)));
+    if (!this->handleFileOutput(*conn)) {
+        if (this->requestData.summary || this->requestData.format != OUTPUT_TEXT) {
+            // Nothing prints the body, so it is only counted, however large it is
+            readResponseBody(*conn, req.method == "HEAD", this->response, [this](const char *, size_t size) {
+                this->bodyBytes += size;
+                return true;
+            });
+        } else {
+            readResponseBody(*conn, req.method == "HEAD", this->response);
+            this->bodyBytes = this->response.body.size();
+        }
+    }
+    this->timing.receive = micros(headRead, std::chrono::steady_clock::now());
+
+    // Answer a Digest challenge once per attempt, with the credentials from --auth-digest.
+    // The answer is only good for this challenge's nonce, so it never joins outgoing's
+    // headers: a retry, hedge or replay answers its own challenge.
+    if (this->response.status == 401 && this->requestData.authData.empty() && !this->requestData.authDigest.empty()
+        && this->digestAuthorization.empty() && !this->outgoing.headers.has("Authorization"))
     {
+        httplib::Response challenge;
+        challenge.set_header("WWW-Authenticate", std::string(this->response.headers.get("WWW-Authenticate")));
+        std::map<std::string, std::string> auth;
         auto colonPos = this->requestData.authDigest.find(':');
-        if (colonPos != std::string::npos) {
-            cli->set_digest_auth(this->requestData.authDigest.substr(0, colonPos),
-                                 this->requestData.authDigest.substr(colonPos + 1));
-        }
+        if (colonPos == std::string::npos || !httplib::detail::parse_www_authenticate(challenge, auth, false))
+            return;
+
+        // Only qop=auth-int hashes the body, otherwise mapped file parts stay unread
+        httplib::Request digestReq;
+        digestReq.method = req.method;
+        digestReq.path = req.path;
+        if (auth.count("qop") != 0 && auth["qop"].find("auth-int") != std::string::npos)
+            digestReq.body = req.body.flatten();
+        auto header = httplib::detail::make_digest_authentication_header(
+                digestReq, auth, 1, httplib::detail::random_string(10),
+                this->requestData.authDigest.substr(0, colonPos), this->requestData.authDigest.substr(colonPos + 1));
+        this->digestAuthorization = header.second;
 
-        this->authTypeDefined = true;
+        if (!this->response.keepAlive)
+            conn->reconnect();
+        this->exchange(conn);
     }
+}
 
-    else if (!this->requestData.authBearerToken.empty() && !this->authTypeDefined)
-    {
-        cli->set_bearer_token_auth(this->requestData.authBearerToken);
-        this->authTypeDefined = true;
+void KxHTTP::HTTPRequest::hedge(std::unique_ptr<Connection>& conn)
+{
+    // Both waits end at --max-time, waitReadable() throws the deadline error then
+    int delay = hedgePolicy().delayMs();
+    Connection *primary = conn.get();
+    if (delay < 0 || Connection::waitReadable(&primary, 1, delay) != -1)
+        return;
+
+    // No answer in time: the same request goes out again on another connection
+    std::unique_ptr<Connection> duplicate;
+    try {
+        bool reused = false;
+        duplicate = this->pool != nullptr ? this->pool->acquire(this->endpoint, reused, this->deadline)
+                                          : std::make_unique<Connection>(this->endpoint, this->deadline);
+        hostRateLimiter().acquire(duplicate->getEndpoint().host);
+
+        std::string head;
+        this->serializeHead(head, duplicate->getEndpoint());
+        this->hedged = true;
+        duplicate->write(head, this->outgoing.body);
+    } catch (const std::runtime_error&) {
+        // A duplicate that cannot be sent leaves the original to finish on its own
+        return;
+    }
+
+    // The first to answer wins, the other still owes a response and is closed.
+    // Past the read timeout the original is kept and its read reports the timeout.
+    Connection *both[] = { conn.get(), duplicate.get() };
+    if (Connection::waitReadable(both, 2, this->endpoint.options.readTimeoutMs) == 1)
+        std::swap(conn, duplicate);
+    duplicate->close();
+}
+
+void KxHTTP::HTTPRequest::serializeHead(std::string& out, const Endpoint& endpoint) const
+{
+    const Request& req = this->outgoing;
+    if (this->digestAuthorization.empty()) {
+        serializeRequestHead(out, req.method, req.path, endpoint, req.headers, req.body.size(), req.sendsContentLength());
+        return;
     }
+
+    HeaderList headers = req.headers;
+    headers.add("Authorization", this->digestAuthorization);
+    serializeRequestHead(out, req.method, req.path, endpoint, headers, req.body.size(), req.sendsContentLength());
 }
 
-httplib::Headers KxHTTP::HTTPRequest::constructHeaders()
+KxHTTP::HeaderList KxHTTP::HTTPRequest::constructHeaders()
 {
-    httplib::Headers headers;
+    HeaderList headers;
     for (const auto& header : this->requestData.headers) {
         auto pos = header.find(':');
         if (pos != std::string::npos) {
-            headers.emplace(header.substr(0, pos), header.substr(pos + 1));
+            std::string_view value(header.c_str() + pos + 1, header.size() - pos - 1);
+            value.remove_prefix(std::min(value.find_first_not_of(' '), value.size()));
+            headers.add(std::string_view(header.c_str(), pos), value);
         }
     }
     for (const auto& cookie : this->requestData.cookies) {
-        headers.emplace("Cookie", cookie);
+        headers.add("Cookie", cookie);
     }
     return headers;
 }
@@ -377,17 +1082,16 @@ KxHTTP::Method KxHTTP::stringToMethod(std::string& m)
     return HTTP_GET;
 }
 
-void KxHTTP::HTTPRequest::handleFileOutput()
+bool KxHTTP::HTTPRequest::handleFileOutput(Connection& conn)
 {
-    if (this->result->status == 200 && !this->requestData.outputFile.empty()) {
-        std::ofstream outFile(this->requestData.outputFile, std::ios::binary);
-        if (outFile.is_open()) {
-            outFile << this->result->body;
-            this->fileOutputStatus = true;
-        } else {
-            throw std::runtime_error("Failed to open " + this->requestData.outputFile + " for writing.\n");
-        }
-    }
+    // Only a successful body is saved, anything else is printed as usual
+    if (this->response.status != 200 || this->requestData.outputFile.empty() || this->outgoing.method == "HEAD")
+        return false;
+
+    this->response.body.clear();
+    this->bodyBytes = saveResponseBody(conn, this->response, this->requestData.outputFile);
+    this->fileOutputStatus = true;
+    return true;
 }
 
 std::string KxHTTP::methodToString(KxHTTP::Method m)
@@ -404,34 +1108,22 @@ std::string KxHTTP::methodToString(KxHTTP::Method m)
     }
 }
 
-std::string KxHTTP::getPathFromUrl(const std::string& url)
+KxHTTP::Endpoint KxHTTP::endpointFromUrl(const KxHTTP::Url &url)
 {
-    // Find position after the protocol delimiter (://)
-    size_t protocolPos = url.find("://");
-    if (protocolPos != std::string::npos) {
-        // Start searching for the first '/' after the protocol
-        size_t pathStart = url.find('/', protocolPos + 3);
-        if (pathStart != std::string::npos) {
-            // Return the path and everything after
-            return url.substr(pathStart);
-        }
-    }
-    return "/";
+    if (!url.isHttps() && !url.isHttp())
+        throw std::runtime_error("Unsupported URL scheme: " + std::string(url.scheme));
+
+    Endpoint endpoint;
+    endpoint.host = std::string(url.host);
+    endpoint.port = url.effectivePort();
+    endpoint.tls = url.isHttps();
+    return endpoint;
 }
 
-std::string KxHTTP::getProtocolAndDomain(const std::string& url)
+KxHTTP::Url KxHTTP::parseRequestUrl(const std::string &url)
 {
-    size_t protocolEnd = url.find("://");
-    if (protocolEnd != std::string::npos) {
-        size_t domainEnd = url.find('/', protocolEnd + 3); // skip "://"
-        if (domainEnd != std::string::npos) {
-            return url.substr(0, domainEnd);
-        } else {
-            return url; // No path part found, return the whole URL
-        }
-    }
-
-    return ""; // No protocol found, return empty string
+    Url parsed;
+    if (!KxHTTP::parseUrl(url, parsed))
+        throw std::runtime_error("Invalid URL, expected http:// or https://: " + url);
+    return parsed;
 }
-
-
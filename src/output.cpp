@@ -0,0 +1,273 @@
+#include <cstdio>
+
+#include "kxhttp.h"
+
+namespace
+{
+    void appendMillis(std::string& out, uint64_t micros)
+    {
+        char buf[32];
+        int n = std::snprintf(buf, sizeof(buf), "%.3f", static_cast<double>(micros) / 1000);
+        out.append(buf, static_cast<size_t>(n));
+    }
+
+    // Length of the well-formed UTF-8 sequence starting at s[i], 0 when it is
+    // not one: stray continuation bytes, overlong forms, surrogates, past U+10FFFF
+    size_t utf8Length(std::string_view s, size_t i)
+    {
+        auto byte = [&s](size_t k) { return static_cast<unsigned char>(s[k]); };
+        unsigned char c = byte(i);
+        size_t length;
+        unsigned char low = 0x80, high = 0xbf; // Allowed range of the second byte
+        if (c >= 0xc2 && c <= 0xdf) {
+            length = 2;
+        } else if (c >= 0xe0 && c <= 0xef) {
+            length = 3;
+            if (c == 0xe0)
+                low = 0xa0;
+            else if (c == 0xed)
+                high = 0x9f;
+        } else if (c >= 0xf0 && c <= 0xf4) {
+            length = 4;
+            if (c == 0xf0)
+                low = 0x90;
+            else if (c == 0xf4)
+                high = 0x8f;
+        } else {
+            return 0;
+        }
+
+        if (i + length > s.size() || byte(i + 1) < low || byte(i + 1) > high)
+            return 0;
+        for (size_t k = 2; k < length; k++) {
+            if ((byte(i + k) & 0xc0) != 0x80)
+                return 0;
+        }
+        return length;
+    }
+}
+
+//
+// Output Functions
+//
+
+void KxHTTP::appendJsonString(std::string& out, std::string_view s)
+{
+    static const char hex[] = "0123456789abcdef";
+    out += '"';
+    for (size_t i = 0; i < s.size(); i++) {
+        char c = s[i];
+        if (static_cast<unsigned char>(c) >= 0x80) {
+            // Valid UTF-8 is copied through, anything else (a Latin-1 error
+            // message, say) becomes U+FFFD so the output stays valid JSON
+            size_t length = utf8Length(s, i);
+            if (length == 0) {
+                out += "\\ufffd";
+            } else {
+                out.append(s.substr(i, length));
+                i += length - 1;
+            }
+            continue;
+        }
+
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    out += "\\u00";
+                    out += hex[(c >> 4) & 0xf];
+                    out += hex[c & 0xf];
+                } else {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
+
+void KxHTTP::appendJsonRecord(std::string& out, const KxHTTP::ResultRecord& record, KxHTTP::OutputFormat format)
+{
+    // Fields are separated the same way in both layouts, only the whitespace differs
+    const bool pretty = format == OUTPUT_JSON;
+    const char *field = pretty ? ",\n  " : ",";
+    const char *nested = pretty ? ",\n    " : ",";
+
+    out += pretty ? "{\n  \"method\": " : "{\"method\":";
+    appendJsonString(out, record.method);
+    out += field;
+    out += pretty ? "\"url\": " : "\"url\":";
+    appendJsonString(out, record.url);
+
+    if (!record.error.empty()) {
+        out += field;
+        out += pretty ? "\"error\": " : "\"error\":";
+        appendJsonString(out, record.error);
+    } else {
+        out += field;
+        out += pretty ? "\"status\": " : "\"status\":";
+        out += std::to_string(record.status);
+
+        // Pairs rather than an object, so repeated headers such as Set-Cookie survive
+        out += field;
+        out += pretty ? "\"headers\": [" : "\"headers\":[";
+        bool first = true;
+        if (record.headers != nullptr) {
+            for (const auto& header : *record.headers) {
+                out += first ? (pretty ? "\n    " : "") : nested;
+                first = false;
+                out += '[';
+                appendJsonString(out, header.name);
+                out += pretty ? ", " : ",";
+                appendJsonString(out, header.value);
+                out += ']';
+            }
+        }
+        out += !first && pretty ? "\n  ]" : "]";
+
+        out += field;
+        out += pretty ? "\"body_bytes\": " : "\"body_bytes\":";
+        out += std::to_string(record.bodyBytes);
+        if (!record.outputFile.empty()) {
+            out += field;
+            out += pretty ? "\"output\": " : "\"output\":";
+            appendJsonString(out, record.outputFile);
+        }
+    }
+
+    out += field;
+    out += pretty ? "\"attempts\": " : "\"attempts\":";
+    out += std::to_string(record.attempts);
+
+    const std::pair<const char *, uint64_t> phases[] = {
+        { "connect", record.timing.connect }, { "tls", record.timing.tls }, { "send", record.timing.send },
+        { "wait", record.timing.wait }, { "receive", record.timing.receive }, { "total", record.timing.total }
+    };
+    out += field;
+    out += pretty ? "\"timing_ms\": {" : "\"timing_ms\":{";
+    for (size_t i = 0; i < sizeof(phases) / sizeof(phases[0]); i++) {
+        out += i == 0 ? (pretty ? "\n    " : "") : nested;
+        appendJsonString(out, phases[i].first);
+        out += pretty ? ": " : ":";
+        appendMillis(out, phases[i].second);
+    }
+    out += pretty ? "\n  }\n}\n" : "}}\n";
+}
+
+//
+// OutputSink Class Implementations
+//
+
+KxHTTP::OutputSink::OutputSink(std::ostream& out, bool ordered) : out(out)
+{
+    this->ordered = ordered;
+    this->head = nullptr;
+    this->sleeping = false;
+    this->closing = false;
+    this->nextSequence = 0;
+    this->thread = std::thread(&OutputSink::writer, this);
+}
+
+KxHTTP::OutputSink::~OutputSink()
+{
+    this->close();
+}
+
+void KxHTTP::OutputSink::submit(uint64_t sequence, std::string result)
+{
+    Node *node = new Node{ sequence, std::move(result), this->head.load(std::memory_order_relaxed) };
+    while (!this->head.compare_exchange_weak(node->next, node))
+        ;
+
+    // The writer sets sleeping before it looks at the list one last time,
+    // so either it sees this node or we see it asleep
+    if (this->sleeping.load()) {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->wake.notify_one();
+    }
+}
+
+void KxHTTP::OutputSink::close()
+{
+    if (!this->thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->closing = true;
+        this->wake.notify_one();
+    }
+    this->thread.join();
+}
+
+void KxHTTP::OutputSink::writer()
+{
+    std::string buffer;
+    buffer.reserve(KXHTTP_OUTPUT_BUFSIZ);
+
+    while (true) {
+        Node *taken = this->head.exchange(nullptr, std::memory_order_acquire);
+        if (taken == nullptr) {
+            // Nothing queued: whatever is buffered goes out now, then wait for more
+            this->write(buffer, true);
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->sleeping = true;
+            this->wake.wait(lock, [this]() { return this->head.load() != nullptr || this->closing; });
+            this->sleeping = false;
+            if (this->head.load() == nullptr)
+                break;
+            continue;
+        }
+
+        // The list comes newest first, reversed it is in submission order
+        Node *list = nullptr;
+        while (taken != nullptr) {
+            Node *next = taken->next;
+            taken->next = list;
+            list = taken;
+            taken = next;
+        }
+
+        while (list != nullptr) {
+            Node *node = list;
+            list = list->next;
+            if (!this->ordered) {
+                buffer += node->result;
+            } else if (node->sequence == this->nextSequence) {
+                buffer += node->result;
+                this->nextSequence++;
+                // Results that finished early follow as soon as their turn comes
+                for (auto it = this->early.begin(); it != this->early.end() && it->first == this->nextSequence;
+                     it = this->early.erase(it)) {
+                    buffer += it->second;
+                    this->nextSequence++;
+                }
+            } else {
+                this->early.emplace(node->sequence, std::move(node->result));
+            }
+            delete node;
+
+            if (buffer.size() >= KXHTTP_OUTPUT_BUFSIZ)
+                this->write(buffer, false);
+        }
+    }
+
+    // Gaps in the sequence are never filled once the sink closes, print what is left
+    for (auto& entry : this->early)
+        buffer += entry.second;
+    this->early.clear();
+    this->write(buffer, true);
+}
+
+void KxHTTP::OutputSink::write(std::string& buffer, bool flush)
+{
+    if (!buffer.empty()) {
+        this->out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    }
+    if (flush)
+        this->out.flush();
+}
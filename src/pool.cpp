@@ -0,0 +1,61 @@
+#include "kxhttp.h"
+
+//
+// ConnectionPool Class Implementations
+//
+
+std::string KxHTTP::ConnectionPool::keyOf(const KxHTTP::Endpoint& ep)
+{
+    // Connections are only shared between requests that would have opened the same socket
+    const ConnectionOptions& o = ep.options;
+    return std::string(ep.tls ? "https|" : "http|") + ep.host + "|" + std::to_string(ep.port) + "|" + ep.unixSocket
+           + "|" + std::to_string(o.readBufferSize) + (o.adaptiveRead ? "a" : "") + (o.tcpNoDelay ? "n" : "")
+           + (o.tcpFastOpen ? "f" : "") + (o.quickAck ? "q" : "") + "|" + std::to_string(o.busyPoll)
+           + "|" + std::to_string(o.sendBuffer) + "|" + std::to_string(o.recvBuffer)
+           + "|" + std::to_string(o.connectTimeoutMs) + "|" + std::to_string(o.readTimeoutMs)
+           + "|" + std::to_string(o.writeTimeoutMs) + "|" + std::to_string(o.tlsTimeoutMs)
+           + "|" + std::to_string(o.deadlineMs);
+}
+
+std::unique_ptr<KxHTTP::Connection> KxHTTP::ConnectionPool::acquire(const KxHTTP::Endpoint& ep, bool& reused,
+                                                                 KxHTTP::Connection::Deadline deadline)
+{
+    std::vector<std::unique_ptr<Connection>> stale;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto it = this->idle.find(keyOf(ep));
+        if (it != this->idle.end()) {
+            auto& list = it->second;
+            auto oldest = std::chrono::steady_clock::now() - std::chrono::seconds(KXHTTP_POOL_IDLE_SECOND);
+            while (!list.empty()) {
+                Idle entry = std::move(list.back());
+                list.pop_back();
+                if (entry.since >= oldest && entry.conn->isReusable()) {
+                    reused = true;
+                    entry.conn->setDeadline(deadline);
+                    return std::move(entry.conn);
+                }
+                stale.push_back(std::move(entry.conn));
+            }
+        }
+    }
+
+    // Stale connections are closed and new ones opened without holding the lock
+    stale.clear();
+    reused = false;
+    return std::make_unique<Connection>(ep, deadline);
+}
+
+void KxHTTP::ConnectionPool::release(std::unique_ptr<KxHTTP::Connection> conn)
+{
+    if (!conn || !conn->isOpen())
+        return;
+
+    // An idle connection belongs to no request, so it carries no deadline either
+    conn->setDeadline(Connection::Deadline::max());
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto& list = this->idle[keyOf(conn->getEndpoint())];
+    if (list.size() < KXHTTP_POOL_MAX_IDLE)
+        list.push_back({ std::move(conn), std::chrono::steady_clock::now() });
+}
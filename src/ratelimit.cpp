@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include "kxhttp.h"
+
+namespace
+{
+    int64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    bool sameHost(const std::string& a, const std::string& b)
+    {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+            return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+        });
+    }
+}
+
+//
+// HostRateLimiter Class Implementations
+//
+
+void KxHTTP::HostRateLimiter::addLimit(const std::string& spec)
+{
+    auto equals = spec.rfind('=');
+    if (equals == std::string::npos || equals == 0)
+        throw std::runtime_error("Invalid --max-rps '" + spec + "', expected HOST=RATE[:BURST]");
+
+    std::string host = spec.substr(0, equals);
+    std::string value = spec.substr(equals + 1);
+    auto colon = value.find(':');
+    double rate = 0;
+    double burst = 1;
+    if (!CLI::detail::lexical_cast(value.substr(0, colon), rate) || rate <= 0
+        || (colon != std::string::npos && (!CLI::detail::lexical_cast(value.substr(colon + 1), burst) || burst < 1)))
+        throw std::runtime_error("Invalid --max-rps '" + spec + "', expected HOST=RATE[:BURST]");
+
+    // IPv6 hosts are matched without brackets, like Endpoint::host
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']')
+        host = host.substr(1, host.size() - 2);
+
+    auto bucket = std::make_unique<Bucket>();
+    bucket->host = host;
+    bucket->intervalNs = static_cast<int64_t>(1e9 / rate);
+    bucket->toleranceNs = static_cast<int64_t>((burst - 1) * bucket->intervalNs);
+
+    // A later limit for the same host replaces the earlier one
+    this->buckets.erase(std::remove_if(this->buckets.begin(), this->buckets.end(), [&](const auto& b) {
+        return sameHost(b->host, host);
+    }), this->buckets.end());
+    this->buckets.push_back(std::move(bucket));
+}
+
+bool KxHTTP::HostRateLimiter::empty() const
+{
+    return this->buckets.empty();
+}
+
+void KxHTTP::HostRateLimiter::clear()
+{
+    this->buckets.clear();
+}
+
+std::vector<std::string> KxHTTP::HostRateLimiter::specs(double share) const
+{
+    std::vector<std::string> out;
+    for (const auto& b : this->buckets) {
+        double rate = 1e9 / static_cast<double>(b->intervalNs) * share;
+        double burst = (static_cast<double>(b->toleranceNs) / static_cast<double>(b->intervalNs) + 1) * share;
+        out.push_back(b->host + "=" + std::to_string(rate) + ":" + std::to_string(std::max(burst, 1.0)));
+    }
+    return out;
+}
+
+void KxHTTP::HostRateLimiter::acquire(const std::string& host) const
+{
+    const Bucket *bucket = nullptr;
+    for (const auto& b : this->buckets) {
+        if (sameHost(b->host, host)) {
+            bucket = b.get();
+            break;
+        }
+    }
+    if (bucket == nullptr)
+        return;
+
+    // Reserve the next slot; whoever loses the race retries with the newer arrival time
+    int64_t now = nowNs();
+    int64_t arrival = bucket->arrivalNs.load(std::memory_order_relaxed);
+    int64_t next;
+    do {
+        next = std::max(arrival, now) + bucket->intervalNs;
+    } while (!bucket->arrivalNs.compare_exchange_weak(arrival, next, std::memory_order_relaxed));
+
+    int64_t sendAt = next - bucket->intervalNs - bucket->toleranceNs;
+    if (sendAt > now)
+        std::this_thread::sleep_for(std::chrono::nanoseconds(sendAt - now));
+}
+
+KxHTTP::HostRateLimiter& KxHTTP::hostRateLimiter()
+{
+    static HostRateLimiter limiter;
+    return limiter;
+}
@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+#include "kxhttp.h"
+
+namespace
+{
+    // Seconds from now a Retry-After asks for, either delta-seconds or an HTTP-date; -1 if unusable
+    double retryAfterSeconds(std::string_view value)
+    {
+        std::string text(value);
+        if (text.empty())
+            return -1;
+
+        // strtod() saturates instead of throwing, however many digits the server sends
+        if (text.find_first_not_of("0123456789") == std::string::npos)
+            return std::min<double>(std::strtod(text.c_str(), nullptr), KXHTTP_RETRY_AFTER_MAX_SECOND);
+
+        std::tm tm {};
+        std::istringstream in(text);
+        in >> std::get_time(&tm, "%a, %d %b %Y %H:%M:%S");
+        if (in.fail())
+            return -1;
+#ifdef _WIN32
+        std::time_t when = _mkgmtime(&tm);
+#else
+        std::time_t when = timegm(&tm);
+#endif
+        return std::max(0.0, std::difftime(when, std::time(nullptr)));
+    }
+
+    double uniform(double high)
+    {
+        thread_local std::mt19937_64 engine{ std::random_device{}() };
+        return std::uniform_real_distribution<double>(0, high)(engine);
+    }
+}
+
+std::vector<int> KxHTTP::parseStatusList(const std::string& spec)
+{
+    std::vector<int> statuses;
+    std::stringstream list(spec);
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        auto dash = item.find('-');
+        std::string first = dash == std::string::npos ? item : item.substr(0, dash);
+        std::string last = dash == std::string::npos ? item : item.substr(dash + 1);
+        int low = 0, high = 0;
+        if (!CLI::detail::lexical_cast(first, low) || !CLI::detail::lexical_cast(last, high)
+            || low < 100 || high > 599 || low > high)
+            throw std::runtime_error("Invalid status list '" + spec + "', expected e.g. 429,502-504");
+        for (int status = low; status <= high; status++)
+            statuses.push_back(status);
+    }
+    return statuses;
+}
+
+//
+// RetryPolicy Class Implementations
+//
+
+void KxHTTP::RetryPolicy::configure(const KxHTTP::RetryOptions& options)
+{
+    this->options = options;
+}
+
+bool KxHTTP::RetryPolicy::enabled() const
+{
+    return this->options.retries > 0;
+}
+
+unsigned KxHTTP::RetryPolicy::maxRetries() const
+{
+    return this->options.retries;
+}
+
+bool KxHTTP::RetryPolicy::retryStatus(int status) const
+{
+    return std::find(this->options.statuses.begin(), this->options.statuses.end(), status) != this->options.statuses.end();
+}
+
+void KxHTTP::RetryPolicy::recordRequest()
+{
+    this->requests.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool KxHTTP::RetryPolicy::takeRetry()
+{
+    uint64_t taken = this->retries.load(std::memory_order_relaxed);
+    do {
+        double allowed = KXHTTP_RETRY_BUDGET_MIN
+                + this->options.budget * static_cast<double>(this->requests.load(std::memory_order_relaxed));
+        if (static_cast<double>(taken + 1) > allowed)
+            return false;
+    } while (!this->retries.compare_exchange_weak(taken, taken + 1, std::memory_order_relaxed));
+    return true;
+}
+
+double KxHTTP::RetryPolicy::delayMs(unsigned retry, std::string_view retryAfter) const
+{
+    double asked = retryAfterSeconds(retryAfter);
+    if (asked >= 0)
+        return std::min<double>(asked, KXHTTP_RETRY_AFTER_MAX_SECOND) * 1000;
+
+    // Full jitter: anywhere between 0 and the exponential ceiling, so clients that
+    // failed together do not come back together
+    double ceiling = std::max(0.0, std::min(this->options.capMs, this->options.baseMs * std::pow(2.0, retry - 1)));
+    return uniform(ceiling);
+}
+
+KxHTTP::RetryPolicy& KxHTTP::retryPolicy()
+{
+    static RetryPolicy policy;
+    return policy;
+}
@@ -0,0 +1,170 @@
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "kxhttp.h"
+
+namespace
+{
+    bool interactive()
+    {
+#ifdef _WIN32
+        return _isatty(_fileno(stdin)) != 0;
+#else
+        return isatty(STDIN_FILENO) != 0;
+#endif
+    }
+
+    std::string headerName(const std::string& header)
+    {
+        std::string name = header.substr(0, header.find(':'));
+        for (auto& c : name) {
+            if (c >= 'A' && c <= 'Z')
+                c = static_cast<char>(c - 'A' + 'a');
+        }
+        return name;
+    }
+}
+
+//
+// Shell Class Implementations
+//
+
+KxHTTP::Shell::Shell(const std::string& baseUrl, KxHTTP::RequestData&& defaults)
+{
+    this->baseUrl = baseUrl;
+    while (!this->baseUrl.empty() && this->baseUrl.back() == '/')
+        this->baseUrl.pop_back();
+    this->defaults = std::move(defaults);
+
+    // Catch a bad base URL now rather than on every line
+    KxHTTP::endpointFromUrl(KxHTTP::parseRequestUrl(this->baseUrl));
+}
+
+void KxHTTP::Shell::run(std::istream& in)
+{
+    const bool prompt = interactive();
+    if (prompt)
+        std::cout << KXHTTP_CONSOLE_YELLOW << "KxHTTP " << KXHTTP_VER << " shell on " << this->baseUrl
+                  << ", type exit to leave" << KXHTTP_CONSOLE_RESET << "\n";
+
+    // A script's results are printed by a writer thread in large writes, while
+    // the next line is already being sent. At a prompt they are printed right away.
+    std::unique_ptr<OutputSink> sink;
+    if (!prompt)
+        sink = std::make_unique<OutputSink>(std::cout, true);
+    uint64_t sequence = 0;
+
+    std::string line;
+    while (true) {
+        if (prompt)
+            std::cout << "kxh> " << std::flush;
+        if (!std::getline(in, line))
+            break;
+
+        auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+        auto end = line.find_first_of(" \t\r", first);
+        std::string command = line.substr(first, end == std::string::npos ? end : end - first);
+        if (command == "exit" || command == "quit")
+            break;
+
+        std::string output = this->execute(line.substr(first));
+        if (sink)
+            sink->submit(sequence++, std::move(output));
+        else
+            std::cout << output << std::flush;
+    }
+    if (sink)
+        sink->close();
+    if (prompt)
+        std::cout << "\n";
+}
+
+std::string KxHTTP::Shell::execute(const std::string& line)
+{
+    std::ostringstream out;
+    try {
+        std::string methodStr;
+        RequestData rd = this->parseLine(line, methodStr);
+        if (methodStr.empty() || rd.url.empty())
+            throw std::runtime_error("Expected a method and a path, e.g. GET /users");
+        rd.method = KxHTTP::stringToMethod(methodStr);
+        rd.url = this->resolveUrl(rd.url);
+
+        HTTPRequest rq(std::move(rd));
+        try {
+            rq.sendRequest(this->pool);
+        } catch (const std::runtime_error& e) {
+            if (this->defaults.format == OUTPUT_TEXT)
+                throw;
+            rq.processError(out, e.what());
+            return out.str();
+        }
+        rq.processResponse(out);
+        if (this->defaults.format == OUTPUT_TEXT && !this->defaults.summary)
+            out << "\n";
+    } catch (const CLI::ParseError& e) {
+        std::cerr << KXHTTP_CONSOLE_RED << "Parsing Error: " << e.what() << KXHTTP_CONSOLE_RESET << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << KXHTTP_CONSOLE_RED << "Error: " << e.what() << KXHTTP_CONSOLE_RESET << std::endl;
+    }
+    return out.str();
+}
+
+KxHTTP::RequestData KxHTTP::Shell::parseLine(const std::string& line, std::string& methodStr)
+{
+    // Connection settings and credentials come from the shell, the body and
+    // the per-line headers from the line itself
+    RequestData rd = this->defaults;
+    rd.headers.clear();
+    rd.cookies.clear();
+
+    CLI::App app("kxh shell");
+    app.set_help_flag();
+    KxHTTP::addRequestTarget(&app, rd, methodStr);
+    KxHTTP::addRequestOptions(&app, rd);
+    app.add_option("-o,--output", rd.outputFile, "Save output to a file");
+    app.parse(line, false);
+
+    // Credentials given on the line replace the shell's instead of mixing with them
+    bool lineAuth = app.count("--auth") + app.count("--auth-digest") + app.count("--auth-token") > 0;
+    if (lineAuth) {
+        if (app.count("--auth") == 0)
+            rd.authData.clear();
+        if (app.count("--auth-digest") == 0)
+            rd.authDigest.clear();
+        if (app.count("--auth-token") == 0)
+            rd.authBearerToken.clear();
+    }
+
+    std::vector<std::string> headers;
+    for (const auto& header : this->defaults.headers) {
+        bool replaced = false;
+        for (const auto& own : rd.headers)
+            replaced = replaced || headerName(own) == headerName(header);
+        if (!replaced)
+            headers.push_back(header);
+    }
+    headers.insert(headers.end(), rd.headers.begin(), rd.headers.end());
+    rd.headers = std::move(headers);
+    rd.cookies.insert(rd.cookies.begin(), this->defaults.cookies.begin(), this->defaults.cookies.end());
+    return rd;
+}
+
+std::string KxHTTP::Shell::resolveUrl(const std::string& target) const
+{
+    if (target.find("://") != std::string::npos)
+        return target;
+    if (target[0] == '/' || target[0] == '?')
+        return this->baseUrl + target;
+    return this->baseUrl + "/" + target;
+}
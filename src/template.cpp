@@ -0,0 +1,123 @@
+#include <cstring>
+#include <random>
+
+#include "kxhttp.h"
+
+namespace
+{
+    void patchDigits(char *out, uint64_t value)
+    {
+        for (int i = KXHTTP_PLACEHOLDER_WIDTH - 1; i >= 0; i--) {
+            out[i] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        }
+    }
+}
+
+//
+// Utility Functions
+//
+
+uint64_t KxHTTP::nextRandom()
+{
+    // xorshift64*, seeded per thread; only needs to be cheap, not secure
+    thread_local uint64_t state = std::random_device{}() | 1;
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DULL;
+}
+
+//
+// RequestTemplate Class Implementations
+//
+
+KxHTTP::RequestTemplate::RequestTemplate(const KxHTTP::Endpoint& ep, const KxHTTP::Request& req)
+{
+    this->endpoint = ep;
+    this->headRequest = req.method == "HEAD";
+
+    // The body is shared with the request unless it has placeholders, in which
+    // case it is expanded first so Content-Length covers the reserved digits.
+    this->body = req.body;
+    if (req.body.isContiguous() && req.body.view().find("{{") != std::string_view::npos) {
+        std::string expanded(req.body.view());
+        this->reservePlaceholders(expanded, true);
+        this->body = Body(std::move(expanded));
+    }
+    this->bodyPlaceholders = !this->placeholders.empty();
+
+    serializeRequestHead(this->head, req.method, req.path, ep, req.headers,
+                         this->body.size(), req.sendsContentLength());
+    this->reservePlaceholders(this->head, false);
+}
+
+void KxHTTP::RequestTemplate::reservePlaceholders(std::string& s, bool inBody)
+{
+    // Scanned left to right, so widening a token never moves an earlier offset
+    size_t pos = 0;
+    while ((pos = s.find("{{", pos)) != std::string::npos) {
+        size_t tokenLength;
+        PlaceholderKind kind;
+        if (s.compare(pos, 7, "{{seq}}") == 0) {
+            tokenLength = 7;
+            kind = PLACEHOLDER_SEQ;
+        } else if (s.compare(pos, 8, "{{rand}}") == 0) {
+            tokenLength = 8;
+            kind = PLACEHOLDER_RAND;
+        } else {
+            pos += 2;
+            continue;
+        }
+
+        s.replace(pos, tokenLength, KXHTTP_PLACEHOLDER_WIDTH, '0');
+        this->placeholders.push_back({ inBody, pos, kind });
+        pos += KXHTTP_PLACEHOLDER_WIDTH;
+    }
+}
+
+const KxHTTP::Endpoint& KxHTTP::RequestTemplate::getEndpoint() const
+{
+    return this->endpoint;
+}
+
+bool KxHTTP::RequestTemplate::isHeadRequest() const
+{
+    return this->headRequest;
+}
+
+bool KxHTTP::RequestTemplate::hasPlaceholders() const
+{
+    return !this->placeholders.empty();
+}
+
+void KxHTTP::RequestTemplate::write(KxHTTP::Connection& conn, uint64_t sequence, KxHTTP::TemplateScratch& scratch) const
+{
+    std::string_view headBytes = this->head;
+
+    if (!this->placeholders.empty()) {
+        // The scratch copy is made once per worker, after that only digits change
+        if (scratch.head.size() != this->head.size()) {
+            scratch.head = this->head;
+            if (this->bodyPlaceholders)
+                scratch.body = std::string(this->body.view());
+        }
+
+        for (const auto& p : this->placeholders) {
+            char *out = &(p.inBody ? scratch.body : scratch.head)[p.offset];
+            patchDigits(out, p.kind == PLACEHOLDER_SEQ ? sequence : KxHTTP::nextRandom());
+        }
+
+        headBytes = scratch.head;
+    }
+
+    if (this->bodyPlaceholders) {
+        struct iovec iov[2] = {
+            { const_cast<char *>(headBytes.data()), headBytes.size() },
+            { scratch.body.data(), scratch.body.size() }
+        };
+        conn.write(iov, 2);
+    } else {
+        conn.write(headBytes, this->body);
+    }
+}
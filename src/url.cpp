@@ -0,0 +1,195 @@
+#include "kxhttp/url.h"
+
+namespace
+{
+    bool isAlpha(char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
+
+    bool isDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    bool equalsIgnoreCase(std::string_view a, std::string_view lower)
+    {
+        if (a.size() != lower.size())
+            return false;
+        for (size_t i = 0; i < a.size(); i++) {
+            char c = a[i];
+            if (c >= 'A' && c <= 'Z')
+                c = static_cast<char>(c - 'A' + 'a');
+            if (c != lower[i])
+                return false;
+        }
+        return true;
+    }
+
+    // Unreserved and reserved characters (RFC 3986), plus '%' so escapes the
+    // user already wrote are kept, and braces so {{seq}} and {{rand}} still
+    // reach RequestTemplate. Everything else, spaces, controls and non-ASCII
+    // bytes included, is percent-encoded on the wire.
+    bool allowedInTarget(unsigned char c)
+    {
+        if (isAlpha(static_cast<char>(c)) || isDigit(static_cast<char>(c)))
+            return true;
+        switch (c) {
+            case '-': case '.': case '_': case '~':
+            case ':': case '/': case '?': case '#': case '[': case ']': case '@':
+            case '!': case '$': case '&': case '\'': case '(': case ')':
+            case '*': case '+': case ',': case ';': case '=': case '%':
+            case '{': case '}':
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    void appendEncoded(std::string& out, std::string_view s)
+    {
+        static const char hex[] = "0123456789ABCDEF";
+        for (char ch : s) {
+            auto c = static_cast<unsigned char>(ch);
+            if (allowedInTarget(c)) {
+                out += ch;
+            } else {
+                out += '%';
+                out += hex[c >> 4];
+                out += hex[c & 0x0f];
+            }
+        }
+    }
+}
+
+bool KxHTTP::Url::isHttp() const
+{
+    return equalsIgnoreCase(this->scheme, "http");
+}
+
+bool KxHTTP::Url::isHttps() const
+{
+    return equalsIgnoreCase(this->scheme, "https");
+}
+
+int KxHTTP::Url::effectivePort() const
+{
+    if (this->portNumber != 0)
+        return this->portNumber;
+    return this->isHttps() ? 443 : 80;
+}
+
+std::string KxHTTP::Url::requestTarget() const
+{
+    std::string target;
+    target.reserve(this->path.size() + this->query.size() + 2);
+    if (this->path.empty())
+        target += '/';
+    appendEncoded(target, this->path);
+    if (this->query.data() != nullptr) {
+        target += '?';
+        appendEncoded(target, this->query);
+    }
+    return target;
+}
+
+bool KxHTTP::parseUrl(std::string_view input, KxHTTP::Url& url) noexcept
+{
+    url = Url();
+    const size_t n = input.size();
+    size_t i = 0;
+
+    // scheme = ALPHA *( ALPHA / DIGIT / "+" / "-" / "." ) ":"
+    if (n == 0 || !isAlpha(input[0]))
+        return false;
+    while (i < n && (isAlpha(input[i]) || isDigit(input[i]) || input[i] == '+' || input[i] == '-' || input[i] == '.'))
+        i++;
+    if (i >= n || input[i] != ':')
+        return false;
+    url.scheme = input.substr(0, i);
+    i++;
+
+    // Only URLs with an authority make sense for a request
+    if (i + 1 >= n || input[i] != '/' || input[i + 1] != '/')
+        return false;
+    i += 2;
+
+    // The authority ends at the first '/', '?' or '#', whichever comes first.
+    // Userinfo is everything up to the last '@' inside it.
+    size_t authorityStart = i;
+    size_t at = std::string_view::npos;
+    while (i < n && input[i] != '/' && input[i] != '?' && input[i] != '#') {
+        if (input[i] == '@')
+            at = i;
+        i++;
+    }
+    size_t authorityEnd = i;
+
+    size_t hostStart = authorityStart;
+    if (at != std::string_view::npos) {
+        url.userinfo = input.substr(authorityStart, at - authorityStart);
+        hostStart = at + 1;
+    }
+
+    size_t portStart = std::string_view::npos;
+    if (hostStart < authorityEnd && input[hostStart] == '[') {
+        size_t closing = input.find(']', hostStart);
+        if (closing == std::string_view::npos || closing >= authorityEnd)
+            return false;
+        url.host = input.substr(hostStart + 1, closing - hostStart - 1);
+        url.ipv6 = true;
+        if (closing + 1 < authorityEnd) {
+            if (input[closing + 1] != ':')
+                return false;
+            portStart = closing + 2;
+        }
+    } else {
+        size_t h = hostStart;
+        while (h < authorityEnd && input[h] != ':')
+            h++;
+        url.host = input.substr(hostStart, h - hostStart);
+        if (h < authorityEnd)
+            portStart = h + 1;
+    }
+
+    // Spaces and control bytes would end up verbatim in the Host header
+    if (url.host.empty())
+        return false;
+    for (char c : url.host) {
+        if (static_cast<unsigned char>(c) <= 0x20 || c == 0x7f)
+            return false;
+    }
+
+    if (portStart != std::string_view::npos) {
+        url.port = input.substr(portStart, authorityEnd - portStart);
+        int port = 0;
+        for (char c : url.port) {
+            if (!isDigit(c))
+                return false;
+            port = port * 10 + (c - '0');
+            if (port > 65535)
+                return false;
+        }
+        // "host:" with an empty port means the default one, an explicit 0 is no port at all
+        if (!url.port.empty() && port == 0)
+            return false;
+        url.portNumber = port;
+    }
+
+    size_t pathStart = i;
+    while (i < n && input[i] != '?' && input[i] != '#')
+        i++;
+    url.path = input.substr(pathStart, i - pathStart);
+
+    if (i < n && input[i] == '?') {
+        size_t queryStart = ++i;
+        while (i < n && input[i] != '#')
+            i++;
+        url.query = input.substr(queryStart, i - queryStart);
+    }
+
+    if (i < n && input[i] == '#')
+        url.fragment = input.substr(i + 1);
+
+    return true;
+}
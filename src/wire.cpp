@@ -0,0 +1,1141 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+#include "kxhttp.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+namespace
+{
+    // TLS sessions handed out by servers, keyed by Connection::sessionKey, so
+    // reconnects (bench, the daemon's pool) resume instead of a full handshake
+    std::mutex sessionMutex;
+    std::map<std::string, SSL_SESSION *> sessions;
+
+    int storeSession(SSL *ssl, SSL_SESSION *session)
+    {
+        auto *key = static_cast<const std::string *>(SSL_get_app_data(ssl));
+        if (key == nullptr)
+            return 0;
+
+        std::lock_guard<std::mutex> lock(sessionMutex);
+        auto& slot = sessions[*key];
+        if (slot != nullptr)
+            SSL_SESSION_free(slot);
+        slot = session;
+        return 1; // We keep the reference
+    }
+
+    void resumeSession(SSL *ssl, const std::string& key)
+    {
+        std::lock_guard<std::mutex> lock(sessionMutex);
+        auto it = sessions.find(key);
+        if (it != sessions.end())
+            SSL_set_session(ssl, it->second);
+    }
+
+    // Addresses that recently accepted a connection, so a long-lived process
+    // does not resolve the same host for every new connection
+    struct CachedAddress
+    {
+        std::string ip;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    std::mutex addressMutex;
+    std::map<std::string, CachedAddress> addresses;
+
+    std::string cachedAddress(const std::string& host)
+    {
+        std::lock_guard<std::mutex> lock(addressMutex);
+        auto it = addresses.find(host);
+        if (it == addresses.end())
+            return std::string();
+        if (it->second.expires < std::chrono::steady_clock::now()) {
+            addresses.erase(it);
+            return std::string();
+        }
+        return it->second.ip;
+    }
+
+    void rememberAddress(const std::string& host, socket_t sock)
+    {
+        std::string ip;
+        int port = 0;
+        httplib::detail::get_remote_ip_and_port(sock, ip, port);
+        if (ip.empty())
+            return;
+
+        std::lock_guard<std::mutex> lock(addressMutex);
+        addresses[host] = { ip, std::chrono::steady_clock::now() + std::chrono::seconds(KXHTTP_ADDRESS_CACHE_SECOND) };
+    }
+
+    void forgetAddress(const std::string& host)
+    {
+        std::lock_guard<std::mutex> lock(addressMutex);
+        addresses.erase(host);
+    }
+
+    SSL_CTX *clientContext()
+    {
+        // One context for the whole process, OpenSSL makes SSL_new() on it thread-safe
+        static SSL_CTX *ctx = []() {
+            SSL_CTX *c = SSL_CTX_new(TLS_client_method());
+            if (c == nullptr)
+                throw std::runtime_error("Failed to initialize OpenSSL");
+
+            auto loaded = false;
+#ifdef _WIN32
+            loaded = httplib::detail::load_system_certs_on_windows(SSL_CTX_get_cert_store(c));
+#endif
+            if (!loaded)
+                SSL_CTX_set_default_verify_paths(c);
+
+            SSL_CTX_set_verify(c, SSL_VERIFY_PEER, nullptr);
+
+            // Client sessions are cached by us, see storeSession()
+            SSL_CTX_set_session_cache_mode(c, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+            SSL_CTX_sess_set_new_cb(c, storeSession);
+
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(KXHTTP_DISABLE_KTLS)
+            // Let the kernel do record encryption when the cipher and kernel allow it,
+            // OpenSSL quietly stays in user space otherwise
+            SSL_CTX_set_options(c, SSL_OP_ENABLE_KTLS);
+#endif
+            return c;
+        }();
+        return ctx;
+    }
+
+    // Switches a socket to non-blocking mode for one scope
+    class NonBlockingScope
+    {
+        public:
+            NonBlockingScope(socket_t sock, bool active) : sock(sock), active(active)
+            {
+                if (this->active)
+                    httplib::detail::set_nonblocking(this->sock, true);
+            }
+
+            ~NonBlockingScope()
+            {
+                if (this->active)
+                    httplib::detail::set_nonblocking(this->sock, false);
+            }
+
+        private:
+            socket_t sock;
+            bool active;
+    };
+
+    bool resetByPeer()
+    {
+#ifdef _WIN32
+        int err = WSAGetLastError();
+        return err == WSAECONNRESET || err == WSAECONNABORTED;
+#else
+        return errno == ECONNRESET || errno == EPIPE;
+#endif
+    }
+
+    // SO_RCVTIMEO and SO_SNDTIMEO running out, as opposed to the connection failing
+    bool socketTimedOut()
+    {
+#ifdef _WIN32
+        return WSAGetLastError() == WSAETIMEDOUT;
+#else
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+    }
+
+    // On a blocking socket OpenSSL reports a socket timeout as a want-read or
+    // want-write, or as a syscall error when the record layer saw it first
+    bool sslTimedOut(int err)
+    {
+        return err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE || (err == SSL_ERROR_SYSCALL && socketTimedOut());
+    }
+
+    void setIntOption(socket_t sock, int level, int name, int value)
+    {
+        // Tuning is best effort, an option the kernel refuses just stays at its default
+        setsockopt(sock, level, name, reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    // Options that have to be in place before connect(), e.g. buffer sizes
+    // decide the window scale advertised in the SYN
+    void applySocketOptions(socket_t sock, const KxHTTP::ConnectionOptions& options)
+    {
+        if (options.sendBuffer > 0)
+            setIntOption(sock, SOL_SOCKET, SO_SNDBUF, options.sendBuffer);
+        if (options.recvBuffer > 0)
+            setIntOption(sock, SOL_SOCKET, SO_RCVBUF, options.recvBuffer);
+#ifdef SO_BUSY_POLL
+        if (options.busyPoll > 0)
+            setIntOption(sock, SOL_SOCKET, SO_BUSY_POLL, options.busyPoll);
+#endif
+#ifdef TCP_FASTOPEN_CONNECT
+        // connect() returns at once and the first write (request or ClientHello) rides in the SYN
+        if (options.tcpFastOpen)
+            setIntOption(sock, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, 1);
+#endif
+    }
+
+    std::string_view trim(std::string_view s)
+    {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+            s.remove_prefix(1);
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+            s.remove_suffix(1);
+        return s;
+    }
+
+    void readFixed(KxHTTP::Connection& conn, uint64_t length, const KxHTTP::BodySink& sink)
+    {
+        while (length > 0) {
+            if (conn.buffered().empty() && !conn.fill())
+                throw std::runtime_error("Connection closed before the response body was complete");
+
+            auto chunk = conn.buffered();
+            size_t n = static_cast<size_t>(std::min<uint64_t>(chunk.size(), length));
+            if (!sink(chunk.data(), n))
+                throw std::runtime_error("Response body was rejected by the output");
+            conn.consume(n);
+            length -= n;
+        }
+    }
+
+    bool contentLength(const KxHTTP::Response& res, uint64_t& length)
+    {
+        if (!res.headers.has("Content-Length"))
+            return false;
+        // The whole value has to be digits, "12abc" is malformed rather than 12
+        auto value = trim(res.headers.get("Content-Length"));
+        auto parsed = std::from_chars(value.data(), value.data() + value.size(), length);
+        if (parsed.ec != std::errc() || parsed.ptr != value.data() + value.size())
+            throw std::runtime_error("Malformed Content-Length in response");
+        return true;
+    }
+
+    // RFC 9112 6.3: only a last transfer coding of chunked frames the body. Any
+    // Transfer-Encoding overrides Content-Length, so with another last coding
+    // the body runs until the server closes the connection.
+    bool chunkedBody(const KxHTTP::Response& res)
+    {
+        std::string_view codings;
+        for (const auto& header : res.headers) {
+            if (header.lowerName == "transfer-encoding")
+                codings = header.value;
+        }
+        size_t comma = codings.rfind(',');
+        return KxHTTP::equalsLower("chunked", trim(comma == std::string_view::npos ? codings : codings.substr(comma + 1)));
+    }
+
+    bool lengthDelimited(const KxHTTP::Response& res, uint64_t& length)
+    {
+        return !res.headers.has("Transfer-Encoding") && contentLength(res, length);
+    }
+
+#ifdef __linux__
+    void writeFile(int fd, const char *data, size_t size)
+    {
+        while (size > 0) {
+            ssize_t n = httplib::detail::handle_EINTR([&]() { return ::write(fd, data, size); });
+            if (n <= 0)
+                throw std::runtime_error("Failed to write the response body to disk");
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+    }
+#endif
+
+    std::string_view readLine(KxHTTP::Connection& conn)
+    {
+        size_t eol;
+        while ((eol = conn.buffered().find("\r\n")) == std::string_view::npos) {
+            if (!conn.fill())
+                throw std::runtime_error("Connection closed in the middle of a chunked response");
+        }
+        return conn.buffered().substr(0, eol);
+    }
+
+    void readChunked(KxHTTP::Connection& conn, const KxHTTP::BodySink& sink)
+    {
+        while (true) {
+            auto line = readLine(conn);
+            size_t lineLength = line.size() + 2;
+
+            uint64_t chunkSize = 0;
+            auto sizeText = trim(line.substr(0, line.find(';')));
+            auto parsed = std::from_chars(sizeText.data(), sizeText.data() + sizeText.size(), chunkSize, 16);
+            if (parsed.ec != std::errc() || sizeText.empty())
+                throw std::runtime_error("Malformed chunk size in response");
+            conn.consume(lineLength);
+
+            if (chunkSize == 0)
+                break;
+
+            readFixed(conn, chunkSize, sink);
+            if (readLine(conn).size() != 0)
+                throw std::runtime_error("Malformed chunk terminator in response");
+            conn.consume(2);
+        }
+
+        // Trailers are read and dropped, an empty line ends the body
+        while (true) {
+            auto line = readLine(conn);
+            conn.consume(line.size() + 2);
+            if (line.empty())
+                break;
+        }
+    }
+}
+
+//
+// Endpoint Implementations
+//
+
+std::string KxHTTP::Endpoint::hostHeader() const
+{
+    std::string value = this->host.find(':') != std::string::npos ? "[" + this->host + "]" : this->host;
+    if ((this->tls && this->port != 443) || (!this->tls && this->port != 80))
+        value += ":" + std::to_string(this->port);
+    return value;
+}
+
+//
+// Connection Class Implementations
+//
+
+KxHTTP::Connection::Connection(const KxHTTP::Endpoint& ep, Deadline deadline)
+{
+    this->endpoint = ep;
+    this->deadline = deadline;
+    this->sock = INVALID_SOCKET;
+    this->ssl = nullptr;
+    this->readBuffer.resize(std::max<size_t>(ep.options.readBufferSize, 1));
+    this->readPos = 0;
+    this->readEnd = 0;
+    this->fullReads = 0;
+    this->received = 0;
+    this->open();
+}
+
+KxHTTP::Connection::~Connection()
+{
+    this->close();
+}
+
+void KxHTTP::Connection::open()
+{
+    const ConnectionOptions& options = this->endpoint.options;
+    const bool local = !this->endpoint.unixSocket.empty();
+#ifdef _WIN32
+    if (local)
+        throw std::runtime_error("Unix domain sockets are not supported on this platform");
+#endif
+
+    // httplib treats the host as a socket path when the family is AF_UNIX,
+    // and skips the resolver when it is given an IP
+    auto connect = [&](const std::string& ip, httplib::Error& error) {
+        int connectMs = this->budgetMs(options.connectTimeoutMs);
+        return httplib::detail::create_client_socket(
+                local ? this->endpoint.unixSocket : this->endpoint.host, ip, this->endpoint.port,
+                local ? AF_UNIX : AF_UNSPEC, options.tcpNoDelay,
+                [&options](socket_t s) { applySocketOptions(s, options); },
+                connectMs / 1000, (connectMs % 1000) * 1000,
+                options.readTimeoutMs / 1000, (options.readTimeoutMs % 1000) * 1000,
+                options.writeTimeoutMs / 1000, (options.writeTimeoutMs % 1000) * 1000,
+                std::string(), error);
+    };
+
+    this->dropped = false;
+    auto started = std::chrono::steady_clock::now();
+    auto since = [](std::chrono::steady_clock::time_point t) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - t).count());
+    };
+    this->opened = OpenTiming();
+
+    httplib::Error error = httplib::Error::Success;
+    std::string ip = local ? std::string() : cachedAddress(this->endpoint.host);
+    this->sock = connect(ip, error);
+    if (this->sock == INVALID_SOCKET && !ip.empty()) {
+        // The cached address went away, resolve again
+        forgetAddress(this->endpoint.host);
+        ip.clear();
+        this->sock = connect(ip, error);
+    }
+    if (this->sock != INVALID_SOCKET && !local && ip.empty())
+        rememberAddress(this->endpoint.host, this->sock);
+
+    if (this->sock == INVALID_SOCKET)
+        throw std::runtime_error("Could not connect to " + (local ? this->endpoint.unixSocket : this->endpoint.hostHeader())
+                                 + " (" + httplib::to_string(error) + ")");
+
+    this->opened.connect = since(started);
+    this->quickAck();
+    if (!this->endpoint.tls)
+        return;
+
+    this->ssl = SSL_new(clientContext());
+    SSL_set_fd(this->ssl, static_cast<int>(this->sock));
+
+    this->sessionKey = this->endpoint.unixSocket + "|" + this->endpoint.hostHeader();
+    SSL_set_app_data(this->ssl, &this->sessionKey);
+    resumeSession(this->ssl, this->sessionKey);
+
+    // IP literals are checked against the certificate's IP SANs and get no SNI
+    const char *host = this->endpoint.host.c_str();
+    if (!X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(this->ssl), host)) {
+        SSL_set_tlsext_host_name(this->ssl, host);
+        SSL_set1_host(this->ssl, host);
+    }
+
+    // The handshake runs non-blocking against one deadline, so a server that
+    // trickles its records out cannot stretch it past the budget
+    auto handshakeStart = std::chrono::steady_clock::now();
+    auto handshakeEnd = handshakeStart + std::chrono::milliseconds(this->budgetMs(options.tlsTimeoutMs));
+    httplib::detail::set_nonblocking(this->sock, true);
+
+    std::string reason;
+    while (true) {
+        int result = SSL_connect(this->ssl);
+        if (result == 1)
+            break;
+
+        int err = SSL_get_error(this->ssl, result);
+        auto left = std::chrono::duration_cast<std::chrono::microseconds>(handshakeEnd - std::chrono::steady_clock::now()).count();
+        if (err != SSL_ERROR_WANT_READ && err != SSL_ERROR_WANT_WRITE) {
+            long verifyResult = SSL_get_verify_result(this->ssl);
+            reason = verifyResult != X509_V_OK ? X509_verify_cert_error_string(verifyResult) : "TLS handshake failed";
+            break;
+        }
+        ssize_t ready = left <= 0 ? 0
+                : err == SSL_ERROR_WANT_READ ? httplib::detail::select_read(this->sock, left / 1000000, left % 1000000)
+                : httplib::detail::select_write(this->sock, left / 1000000, left % 1000000);
+        if (ready <= 0) {
+            reason = "TLS handshake timed out";
+            break;
+        }
+    }
+
+    if (!reason.empty()) {
+        this->close();
+        throw std::runtime_error("SSL connection to " + this->endpoint.hostHeader() + " failed (" + reason + ")");
+    }
+    httplib::detail::set_nonblocking(this->sock, false);
+    this->opened.tls = since(handshakeStart);
+}
+
+bool KxHTTP::Connection::peerDropped() const
+{
+    return this->dropped;
+}
+
+uint64_t KxHTTP::Connection::bytesReceived() const
+{
+    return this->received;
+}
+
+KxHTTP::OpenTiming KxHTTP::Connection::takeOpenTiming()
+{
+    OpenTiming timing = this->opened;
+    this->opened = OpenTiming();
+    return timing;
+}
+
+int KxHTTP::Connection::budgetMs(int timeoutMs) const
+{
+    if (this->deadline == Deadline::max())
+        return timeoutMs;
+
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(this->deadline - std::chrono::steady_clock::now()).count();
+    if (left <= 0)
+        throw std::runtime_error("Request to " + this->endpoint.hostHeader() + " ran past its deadline");
+    return static_cast<int>(std::min<int64_t>(timeoutMs, left));
+}
+
+void KxHTTP::Connection::armTimeout(int name, int timeoutMs)
+{
+#ifdef _WIN32
+    DWORD timeout = static_cast<DWORD>(timeoutMs);
+    setsockopt(this->sock, SOL_SOCKET, name, reinterpret_cast<const char *>(&timeout), sizeof(timeout));
+#else
+    struct timeval tv;
+    tv.tv_sec = timeoutMs / 1000;
+    tv.tv_usec = (timeoutMs % 1000) * 1000;
+    setsockopt(this->sock, SOL_SOCKET, name, &tv, sizeof(tv));
+#endif
+}
+
+void KxHTTP::Connection::armDeadline(int name)
+{
+    // Re-armed before every read or write call, so neither a slow sender nor a
+    // slowly draining peer can carry a request past its deadline. Without a
+    // deadline the timeouts set at connect stand.
+    if (this->deadline == Deadline::max())
+        return;
+    const ConnectionOptions& options = this->endpoint.options;
+    this->armTimeout(name, this->budgetMs(name == SO_SNDTIMEO ? options.writeTimeoutMs : options.readTimeoutMs));
+}
+
+bool KxHTTP::Connection::waitWritable()
+{
+    int timeoutMs = this->budgetMs(this->endpoint.options.writeTimeoutMs);
+    return httplib::detail::select_write(this->sock, timeoutMs / 1000, (timeoutMs % 1000) * 1000) > 0;
+}
+
+void KxHTTP::Connection::setDeadline(Deadline deadline)
+{
+    this->deadline = deadline;
+    if (deadline == Deadline::max() && this->isOpen()) {
+        this->armTimeout(SO_RCVTIMEO, this->endpoint.options.readTimeoutMs);
+        this->armTimeout(SO_SNDTIMEO, this->endpoint.options.writeTimeoutMs);
+    }
+}
+
+void KxHTTP::Connection::reconnect()
+{
+    this->close();
+    this->open();
+}
+
+void KxHTTP::Connection::close()
+{
+    if (this->ssl != nullptr) {
+        SSL_shutdown(this->ssl);
+        SSL_free(this->ssl);
+        this->ssl = nullptr;
+    }
+
+    if (this->sock != INVALID_SOCKET) {
+        httplib::detail::shutdown_socket(this->sock);
+        httplib::detail::close_socket(this->sock);
+        this->sock = INVALID_SOCKET;
+    }
+
+    this->readPos = 0;
+    this->readEnd = 0;
+}
+
+bool KxHTTP::Connection::isOpen() const
+{
+    return this->sock != INVALID_SOCKET;
+}
+
+bool KxHTTP::Connection::isReusable() const
+{
+    if (!this->isOpen() || this->readPos != this->readEnd)
+        return false;
+
+#ifdef _WIN32
+    return true;
+#else
+    // An idle keep-alive connection has nothing to read. EOF means the server
+    // closed it, anything else is data we did not ask for.
+    char c;
+    ssize_t n = recv(this->sock, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+#endif
+}
+
+const KxHTTP::Endpoint& KxHTTP::Connection::getEndpoint() const
+{
+    return this->endpoint;
+}
+
+void KxHTTP::Connection::write(const struct iovec *iov, int count, bool more)
+{
+    if (this->ssl != nullptr) {
+        for (int i = 0; i < count; i++) {
+            const char *data = static_cast<const char *>(iov[i].iov_base);
+            size_t left = iov[i].iov_len;
+            while (left > 0) {
+                this->armDeadline(SO_SNDTIMEO);
+                int n = SSL_write(this->ssl, data, static_cast<int>(std::min<size_t>(left, INT32_MAX)));
+                if (n <= 0) {
+                    int err = SSL_get_error(this->ssl, n);
+                    this->dropped = err == SSL_ERROR_SYSCALL && resetByPeer();
+                    throw std::runtime_error(sslTimedOut(err)
+                            ? "Timed out writing request to " + this->endpoint.hostHeader()
+                            : "Failed to write request to " + this->endpoint.hostHeader());
+                }
+                data += n;
+                left -= static_cast<size_t>(n);
+            }
+        }
+        return;
+    }
+
+#ifdef _WIN32
+    for (int i = 0; i < count; i++) {
+        const char *data = static_cast<const char *>(iov[i].iov_base);
+        size_t left = iov[i].iov_len;
+        while (left > 0) {
+            this->armDeadline(SO_SNDTIMEO);
+            ssize_t n = httplib::detail::send_socket(this->sock, data, left, 0);
+            if (n <= 0) {
+                this->dropped = n < 0 && resetByPeer();
+                throw std::runtime_error("Failed to write request to " + this->endpoint.hostHeader());
+            }
+            data += n;
+            left -= static_cast<size_t>(n);
+        }
+    }
+#else
+    // sendmsg() is writev() with flags, which lets us avoid SIGPIPE on a dropped peer
+    struct iovec pending[64];
+    const int batch = static_cast<int>(sizeof(pending) / sizeof(pending[0]));
+
+    while (count > 0) {
+        int n = std::min(count, batch);
+        std::copy(iov, iov + n, pending);
+        iov += n;
+        count -= n;
+
+        struct iovec *cur = pending;
+        while (n > 0) {
+            struct msghdr msg {};
+            msg.msg_iov = cur;
+            msg.msg_iovlen = static_cast<decltype(msg.msg_iovlen)>(n);
+
+            int flags = 0;
+#ifdef MSG_NOSIGNAL
+            flags |= MSG_NOSIGNAL;
+#endif
+#ifdef MSG_MORE
+            // Tell the kernel more data follows (e.g. a sendfile()) so it can fill segments
+            if (more && count == 0)
+                flags |= MSG_MORE;
+#endif
+            this->armDeadline(SO_SNDTIMEO);
+            ssize_t written = httplib::detail::handle_EINTR([&]() { return sendmsg(this->sock, &msg, flags); });
+            if (written < 0) {
+                this->dropped = resetByPeer();
+                throw std::runtime_error(errno == EAGAIN || errno == EWOULDBLOCK
+                        ? "Timed out writing request to " + this->endpoint.hostHeader()
+                        : "Failed to write request to " + this->endpoint.hostHeader());
+            }
+
+            // Skip fully written buffers and trim a partially written one
+            size_t left = static_cast<size_t>(written);
+            while (n > 0 && left >= cur->iov_len) {
+                left -= cur->iov_len;
+                cur++;
+                n--;
+            }
+            if (n > 0) {
+                cur->iov_base = static_cast<char *>(cur->iov_base) + left;
+                cur->iov_len -= left;
+            }
+        }
+    }
+#endif
+}
+
+void KxHTTP::Connection::write(std::string_view data)
+{
+    struct iovec iov = { const_cast<char *>(data.data()), data.size() };
+    this->write(&iov, 1);
+}
+
+void KxHTTP::Connection::write(std::string_view head, const KxHTTP::Body& body)
+{
+    this->pendingIov.clear();
+    this->pendingIov.push_back({ const_cast<char *>(head.data()), head.size() });
+
+    if (!this->canSendFile()) {
+        body.gather(this->pendingIov);
+        this->write(this->pendingIov.data(), static_cast<int>(this->pendingIov.size()));
+        return;
+    }
+
+    // Memory parts are batched into writev(), large files go through sendfile()
+    // so the kernel moves their pages to the socket without touching user space
+    for (const auto& part : body.getParts()) {
+        if (part.file && part.file->size() >= KXHTTP_SENDFILE_THRESHOLD) {
+            this->write(this->pendingIov.data(), static_cast<int>(this->pendingIov.size()), true);
+            this->pendingIov.clear();
+            this->sendFile(*part.file);
+        } else if (part.file) {
+            if (part.file->size() > 0)
+                this->pendingIov.push_back({ const_cast<char *>(part.file->data()), part.file->size() });
+        } else {
+            this->pendingIov.push_back({ const_cast<char *>(part.bytes.data()), part.bytes.size() });
+        }
+    }
+
+    if (!this->pendingIov.empty())
+        this->write(this->pendingIov.data(), static_cast<int>(this->pendingIov.size()));
+}
+
+bool KxHTTP::Connection::canSendFile() const
+{
+#ifdef __linux__
+    return this->ssl == nullptr || this->kernelTlsSend();
+#else
+    return false;
+#endif
+}
+
+bool KxHTTP::Connection::kernelTlsSend() const
+{
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(KXHTTP_DISABLE_KTLS)
+    return this->ssl != nullptr && BIO_get_ktls_send(SSL_get_wbio(this->ssl));
+#else
+    return false;
+#endif
+}
+
+void KxHTTP::Connection::sendFile(const KxHTTP::MappedFile& file)
+{
+    // sendfile() starts its send timeout over for every page it moves, so a slowly
+    // draining peer could hold it past a deadline. Under one the socket is made
+    // non-blocking and the wait for room happens in waitWritable() instead.
+    const bool paced = this->deadline != Deadline::max() && this->canSendFile() && file.descriptor() != -1;
+    NonBlockingScope scope(this->sock, paced);
+    const std::string timedOut = "Timed out writing request to " + this->endpoint.hostHeader();
+
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(KXHTTP_DISABLE_KTLS)
+    // With kTLS the kernel encrypts, so the file still never enters user space
+    if (this->kernelTlsSend() && file.descriptor() != -1) {
+        off_t offset = 0;
+        size_t left = file.size();
+        while (left > 0) {
+            ossl_ssize_t n = SSL_sendfile(this->ssl, file.descriptor(), offset, std::min<size_t>(left, 0x7ffff000), 0);
+            if (n <= 0 && paced && SSL_get_error(this->ssl, static_cast<int>(n)) == SSL_ERROR_WANT_WRITE) {
+                if (!this->waitWritable())
+                    throw std::runtime_error(timedOut);
+                continue;
+            }
+            if (n <= 0) {
+                this->dropped = resetByPeer();
+                throw std::runtime_error("Failed to write request to " + this->endpoint.hostHeader());
+            }
+            offset += n;
+            left -= static_cast<size_t>(n);
+        }
+        return;
+    }
+#endif
+
+#ifdef __linux__
+    if (this->ssl == nullptr && file.descriptor() != -1) {
+        off_t offset = 0;
+        size_t left = file.size();
+        while (left > 0) {
+            ssize_t n = sendfile(this->sock, file.descriptor(), &offset, std::min<size_t>(left, 0x7ffff000));
+            if (n < 0 && errno == EINTR)
+                continue;
+            bool wouldBlock = n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+            if (wouldBlock && paced) {
+                if (!this->waitWritable())
+                    throw std::runtime_error(timedOut);
+                continue;
+            }
+            if (n <= 0) {
+                this->dropped = n < 0 && resetByPeer();
+                throw std::runtime_error(wouldBlock ? timedOut : "Failed to write request to " + this->endpoint.hostHeader());
+            }
+            left -= static_cast<size_t>(n);
+        }
+        return;
+    }
+#endif
+
+    this->write(std::string_view(file.data(), file.size()));
+}
+
+bool KxHTTP::Connection::canSplice() const
+{
+#ifdef __linux__
+    return this->ssl == nullptr;
+#else
+    return false;
+#endif
+}
+
+void KxHTTP::Connection::spliceTo(int fd, uint64_t length)
+{
+#ifdef __linux__
+    // Whatever came in with the response head is written out first
+    auto pending = this->buffered();
+    size_t head = static_cast<size_t>(std::min<uint64_t>(pending.size(), length));
+    writeFile(fd, pending.data(), head);
+    this->consume(head);
+    length -= head;
+    if (length == 0)
+        return;
+
+    // socket -> pipe -> file, the payload pages never cross into user space
+    int pipefd[2];
+    if (pipe2(pipefd, O_CLOEXEC) == -1)
+        throw std::runtime_error("Failed to create a pipe for the download");
+    int capacity = fcntl(pipefd[1], F_SETPIPE_SZ, KXHTTP_SPLICE_PIPE_SIZE);
+    if (capacity <= 0)
+        capacity = fcntl(pipefd[1], F_GETPIPE_SZ);
+
+    try {
+        while (length > 0) {
+            this->armDeadline(SO_RCVTIMEO);
+            size_t want = static_cast<size_t>(std::min<uint64_t>(length, static_cast<uint64_t>(capacity)));
+            ssize_t in = httplib::detail::handle_EINTR([&]() {
+                return splice(this->sock, nullptr, pipefd[1], nullptr, want, SPLICE_F_MOVE | SPLICE_F_MORE);
+            });
+            if (in == 0)
+                throw std::runtime_error("Connection closed before the response body was complete");
+            if (in < 0) {
+                throw std::runtime_error(errno == EAGAIN || errno == EWOULDBLOCK
+                        ? "Timed out reading response from " + this->endpoint.hostHeader()
+                        : "Failed to read response from " + this->endpoint.hostHeader());
+            }
+            length -= static_cast<uint64_t>(in);
+
+            while (in > 0) {
+                ssize_t out = httplib::detail::handle_EINTR([&]() {
+                    return splice(pipefd[0], nullptr, fd, nullptr, static_cast<size_t>(in), SPLICE_F_MOVE | SPLICE_F_MORE);
+                });
+                if (out <= 0)
+                    throw std::runtime_error("Failed to write the response body to disk");
+                in -= out;
+            }
+        }
+    } catch (...) {
+        ::close(pipefd[0]);
+        ::close(pipefd[1]);
+        throw;
+    }
+    ::close(pipefd[0]);
+    ::close(pipefd[1]);
+#else
+    (void)fd;
+    (void)length;
+    throw std::runtime_error("splice() is not available on this platform");
+#endif
+}
+
+void KxHTTP::Connection::quickAck()
+{
+#ifdef TCP_QUICKACK
+    // The kernel drops back to delayed ACKs on its own, so this is re-armed before every read
+    if (this->endpoint.options.quickAck)
+        setIntOption(this->sock, IPPROTO_TCP, TCP_QUICKACK, 1);
+#endif
+}
+
+ssize_t KxHTTP::Connection::readSome(char *buf, size_t size)
+{
+    this->quickAck();
+    this->armDeadline(SO_RCVTIMEO);
+
+    if (this->ssl != nullptr) {
+        int n = SSL_read(this->ssl, buf, static_cast<int>(std::min<size_t>(size, INT32_MAX)));
+        if (n > 0) {
+            this->received += static_cast<uint64_t>(n);
+            return n;
+        }
+
+        int err = SSL_get_error(this->ssl, n);
+        // Plenty of servers close without a close_notify, treat that as EOF too
+        this->dropped = err == SSL_ERROR_ZERO_RETURN || (err == SSL_ERROR_SYSCALL && (n == 0 || resetByPeer()));
+        if (err == SSL_ERROR_ZERO_RETURN || (err == SSL_ERROR_SYSCALL && n == 0))
+            return 0;
+        throw std::runtime_error(sslTimedOut(err)
+                ? "Timed out reading response from " + this->endpoint.hostHeader()
+                : "Failed to read response from " + this->endpoint.hostHeader());
+    }
+
+    ssize_t n = httplib::detail::read_socket(this->sock, buf, size, 0);
+    this->dropped = n == 0 || (n < 0 && resetByPeer());
+    if (n > 0)
+        this->received += static_cast<uint64_t>(n);
+    if (n < 0) {
+        throw std::runtime_error(socketTimedOut()
+                ? "Timed out reading response from " + this->endpoint.hostHeader()
+                : "Failed to read response from " + this->endpoint.hostHeader());
+    }
+    return n;
+}
+
+bool KxHTTP::Connection::fill()
+{
+    if (this->readPos == this->readEnd) {
+        this->readPos = 0;
+        this->readEnd = 0;
+    } else if (this->readEnd == this->readBuffer.size()) {
+        if (this->readPos > 0) {
+            std::memmove(this->readBuffer.data(), this->readBuffer.data() + this->readPos, this->readEnd - this->readPos);
+            this->readEnd -= this->readPos;
+            this->readPos = 0;
+        } else if (this->readBuffer.size() < KXHTTP_MAX_HEAD_SIZE) {
+            // Only a response head can fill the whole buffer without being consumed
+            this->readBuffer.resize(this->readBuffer.size() * 2);
+        } else {
+            throw std::runtime_error("Response head is too large");
+        }
+    }
+
+    size_t space = this->readBuffer.size() - this->readEnd;
+    ssize_t n = this->readSome(this->readBuffer.data() + this->readEnd, space);
+    this->readEnd += static_cast<size_t>(n);
+
+    // Only a read into an empty buffer that fills all of it counts as full. Topping
+    // up a buffer that still held bytes, like the tail after a large transfer, does not.
+    if (this->endpoint.options.adaptiveRead && n > 0)
+        this->adaptReadBuffer(space == this->readBuffer.size() && static_cast<size_t>(n) == space);
+    return n > 0;
+}
+
+void KxHTTP::Connection::adaptReadBuffer(bool fullRead)
+{
+    // A buffer that keeps coming back full means a bulk transfer, so fewer and
+    // bigger reads pay off. Small API responses never trigger this.
+    if (!fullRead) {
+        this->fullReads = 0;
+        return;
+    }
+    if (++this->fullReads < KXHTTP_ADAPTIVE_READ_STREAK || this->readBuffer.size() >= KXHTTP_MAX_READ_BUFSIZ)
+        return;
+
+    this->fullReads = 0;
+    this->readBuffer.resize(std::min(this->readBuffer.size() * 2, KXHTTP_MAX_READ_BUFSIZ));
+
+    // Let the kernel queue a few reads' worth, so the next recv() finds a full buffer
+    this->growReceiveBuffer(static_cast<int>(this->readBuffer.size() * 4));
+}
+
+void KxHTTP::Connection::growReceiveBuffer(int size)
+{
+    // An explicit --rcvbuf is left alone
+    if (this->endpoint.options.recvBuffer > 0)
+        return;
+
+    // Only ever raised, a smaller explicit SO_RCVBUF would just cap autotuning
+    int current = 0;
+    socklen_t length = sizeof(current);
+    if (getsockopt(this->sock, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<char *>(&current), &length) == 0 && current < size)
+        setsockopt(this->sock, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char *>(&size), sizeof(size));
+}
+
+int KxHTTP::Connection::waitReadable(KxHTTP::Connection *const *conns, size_t count, int timeoutMs)
+{
+    // Bytes already buffered, by us or inside the TLS record layer, never show up in poll()
+    for (size_t i = 0; i < count; i++) {
+        if (conns[i]->readPos != conns[i]->readEnd || (conns[i]->ssl != nullptr && SSL_pending(conns[i]->ssl) > 0))
+            return static_cast<int>(i);
+    }
+
+    // Capped by the nearest deadline, and a wait that runs into it throws the
+    // deadline error rather than reporting a plain timeout
+    int waitMs = timeoutMs;
+    std::vector<struct pollfd> fds(count);
+    for (size_t i = 0; i < count; i++) {
+        fds[i].fd = conns[i]->sock;
+        fds[i].events = POLLIN;
+        waitMs = std::min(waitMs, conns[i]->budgetMs(timeoutMs));
+    }
+
+    int ready = httplib::detail::handle_EINTR([&]() { return poll(fds.data(), count, waitMs); });
+    if (ready <= 0) {
+        for (size_t i = 0; i < count; i++)
+            conns[i]->budgetMs(timeoutMs);
+        return -1;
+    }
+
+    // A hang-up or error counts too, the read that follows reports it
+    for (size_t i = 0; i < count; i++) {
+        if (fds[i].revents != 0)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+std::string_view KxHTTP::Connection::buffered() const
+{
+    return {this->readBuffer.data() + this->readPos, this->readEnd - this->readPos};
+}
+
+void KxHTTP::Connection::consume(size_t n)
+{
+    this->readPos += std::min(n, this->readEnd - this->readPos);
+}
+
+//
+// Request/Response Serialization
+//
+
+void KxHTTP::serializeRequestHead(std::string& out, std::string_view method, std::string_view path,
+                                  const KxHTTP::Endpoint& endpoint, const KxHTTP::HeaderList& headers,
+                                  size_t contentLength, bool sendContentLength)
+{
+    out.append(method);
+    out.append(" ");
+    out.append(path.empty() ? "/" : path);
+    out.append(" HTTP/1.1\r\n");
+
+    if (!headers.has("Host"))
+        out.append("Host: ").append(endpoint.hostHeader()).append("\r\n");
+    if (!headers.has("Accept"))
+        out.append("Accept: */*\r\n");
+    if (!headers.has("User-Agent"))
+        out.append("User-Agent: kxh/" KXHTTP_VER "\r\n");
+
+    headers.serialize(out);
+
+    if (sendContentLength && !headers.has("Content-Length"))
+        out.append("Content-Length: ").append(std::to_string(contentLength)).append("\r\n");
+
+    out.append("\r\n");
+}
+
+void KxHTTP::readResponseHead(KxHTTP::Connection& conn, KxHTTP::Response& res)
+{
+    while (true) {
+        size_t headEnd;
+        while ((headEnd = conn.buffered().find("\r\n\r\n")) == std::string_view::npos) {
+            if (!conn.fill())
+                throw std::runtime_error("Connection closed before a response was received");
+        }
+
+        std::string_view head = conn.buffered().substr(0, headEnd + 2);
+        size_t lineEnd = head.find("\r\n");
+        std::string_view statusLine = head.substr(0, lineEnd);
+
+        // HTTP/1.1 200 OK
+        if (statusLine.size() < 12 || statusLine.compare(0, 5, "HTTP/") != 0)
+            throw std::runtime_error("Malformed response status line");
+
+        int status = 0;
+        auto parsed = std::from_chars(statusLine.data() + 9, statusLine.data() + 12, status);
+        if (parsed.ec != std::errc())
+            throw std::runtime_error("Malformed response status code");
+
+        res.status = status;
+        res.headers.clear();
+
+        size_t pos = lineEnd + 2;
+        while (pos < head.size()) {
+            size_t eol = head.find("\r\n", pos);
+            std::string_view line = head.substr(pos, eol - pos);
+            pos = eol + 2;
+
+            size_t colon = line.find(':');
+            if (colon == std::string_view::npos || colon == 0)
+                continue;
+            res.headers.add(line.substr(0, colon), trim(line.substr(colon + 1)));
+        }
+
+        auto connection = res.headers.get("Connection");
+        if (statusLine.compare(0, 8, "HTTP/1.0") == 0)
+            res.keepAlive = equalsLower("keep-alive", connection);
+        else
+            res.keepAlive = !equalsLower("close", connection);
+
+        conn.consume(headEnd + 4);
+
+        // Interim responses (100 Continue and friends) are skipped
+        if (status < 100 || status >= 200 || status == 101)
+            break;
+    }
+}
+
+void KxHTTP::readResponseBody(KxHTTP::Connection& conn, bool headRequest, KxHTTP::Response& res,
+                              const KxHTTP::BodySink& sink)
+{
+    if (headRequest || res.status == 204 || res.status == 304 || res.status < 200)
+        return;
+
+    if (chunkedBody(res)) {
+        readChunked(conn, sink);
+        return;
+    }
+
+    uint64_t length = 0;
+    if (lengthDelimited(res, length)) {
+        readFixed(conn, length, sink);
+        return;
+    }
+
+    // No framing, the body runs until the server closes the connection
+    res.keepAlive = false;
+    do {
+        auto chunk = conn.buffered();
+        if (!chunk.empty() && !sink(chunk.data(), chunk.size()))
+            throw std::runtime_error("Response body was rejected by the output");
+        conn.consume(chunk.size());
+    } while (conn.fill());
+}
+
+void KxHTTP::readResponseBody(KxHTTP::Connection& conn, bool headRequest, KxHTTP::Response& res)
+{
+    res.body.clear();
+    uint64_t length = 0;
+    if (!headRequest && lengthDelimited(res, length))
+        res.body.reserve(static_cast<size_t>(std::min<uint64_t>(length, KXHTTP_MAX_BODY_RESERVE)));
+
+    readResponseBody(conn, headRequest, res, [&res](const char *data, size_t size) {
+        res.body.append(data, size);
+        return true;
+    });
+}
+
+void KxHTTP::readResponse(KxHTTP::Connection& conn, bool headRequest, KxHTTP::Response& res)
+{
+    readResponseHead(conn, res);
+    readResponseBody(conn, headRequest, res);
+}
+
+uint64_t KxHTTP::saveResponseBody(KxHTTP::Connection& conn, KxHTTP::Response& res, const std::string& path)
+{
+    uint64_t saved = 0;
+#ifdef __linux__
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1)
+        throw std::runtime_error("Failed to open " + path + " for writing.\n");
+
+    try {
+        // A plain socket with a known length can be spliced to disk without a single copy
+        uint64_t length = 0;
+        if (conn.canSplice() && lengthDelimited(res, length)) {
+            conn.spliceTo(fd, length);
+            saved = length;
+        } else {
+            readResponseBody(conn, false, res, [fd, &saved](const char *data, size_t size) {
+                writeFile(fd, data, size);
+                saved += size;
+                return true;
+            });
+        }
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+#else
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+        throw std::runtime_error("Failed to open " + path + " for writing.\n");
+
+    readResponseBody(conn, false, res, [&out, &saved](const char *data, size_t size) {
+        out.write(data, static_cast<std::streamsize>(size));
+        saved += size;
+        return static_cast<bool>(out);
+    });
+#endif
+    return saved;
+}
@@ -0,0 +1,339 @@
+// Response parser tests for the native HTTP/1.1 wire layer. Each case
+// serves canned bytes from a loopback socket, plain or TLS, and reads them
+// back through Connection and readResponse(). Build and run with
+// scripts/test-gcc.sh.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+
+#include "kxhttp/wire.h"
+
+#define CHECK(expr) check((expr), #expr, __LINE__)
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool ok, const char *expr, int line)
+    {
+        if (!ok) {
+            std::fprintf(stderr, "  line %d: %s\n", line, expr);
+            failures++;
+        }
+    }
+
+    // A self-signed certificate for 127.0.0.1, trusted through SSL_CERT_FILE
+    struct TestCertificate
+    {
+        EVP_PKEY *key = nullptr;
+        X509 *cert = nullptr;
+        std::string path;
+
+        TestCertificate()
+        {
+            this->key = EVP_EC_gen("P-256");
+            this->cert = X509_new();
+            X509_set_version(this->cert, 2);
+            ASN1_INTEGER_set(X509_get_serialNumber(this->cert), 1);
+            X509_gmtime_adj(X509_getm_notBefore(this->cert), 0);
+            X509_gmtime_adj(X509_getm_notAfter(this->cert), 3600);
+            X509_set_pubkey(this->cert, this->key);
+
+            X509_NAME *name = X509_get_subject_name(this->cert);
+            X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                                       reinterpret_cast<const unsigned char *>("127.0.0.1"), -1, -1, 0);
+            X509_set_issuer_name(this->cert, name);
+
+            X509V3_CTX ctx;
+            X509V3_set_ctx(&ctx, this->cert, this->cert, nullptr, nullptr, 0);
+            X509_EXTENSION *san = X509V3_EXT_conf_nid(nullptr, &ctx, NID_subject_alt_name, "IP:127.0.0.1");
+            X509_add_ext(this->cert, san, -1);
+            X509_EXTENSION_free(san);
+            X509_sign(this->cert, this->key, EVP_sha256());
+
+            char file[] = "/tmp/kxh-wire-test-XXXXXX";
+            int fd = mkstemp(file);
+            FILE *out = fdopen(fd, "w");
+            PEM_write_X509(out, this->cert);
+            std::fclose(out);
+            this->path = file;
+            setenv("SSL_CERT_FILE", file, 1);
+        }
+
+        ~TestCertificate()
+        {
+            std::remove(this->path.c_str());
+            X509_free(this->cert);
+            EVP_PKEY_free(this->key);
+        }
+    };
+
+    TestCertificate& testCertificate()
+    {
+        static TestCertificate certificate;
+        return certificate;
+    }
+
+    // Accepts one connection, reads the request head and answers with the
+    // given bytes. Closes right after when asked to, otherwise waits for
+    // the client to hang up first.
+    class Server
+    {
+        public:
+            Server(std::string response, bool closeAfter, bool tls = false)
+            {
+                this->listener = socket(AF_INET, SOCK_STREAM, 0);
+                struct sockaddr_in addr {};
+                addr.sin_family = AF_INET;
+                addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                bind(this->listener, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr));
+                listen(this->listener, 1);
+                socklen_t length = sizeof(addr);
+                getsockname(this->listener, reinterpret_cast<struct sockaddr *>(&addr), &length);
+                this->port = ntohs(addr.sin_port);
+
+                SSL_CTX *ctx = nullptr;
+                if (tls) {
+                    ctx = SSL_CTX_new(TLS_server_method());
+                    SSL_CTX_use_certificate(ctx, testCertificate().cert);
+                    SSL_CTX_use_PrivateKey(ctx, testCertificate().key);
+                }
+
+                this->thread = std::thread([this, response, closeAfter, ctx]() {
+                    int sock = accept(this->listener, nullptr, nullptr);
+                    SSL *ssl = nullptr;
+                    if (ctx != nullptr) {
+                        ssl = SSL_new(ctx);
+                        SSL_set_fd(ssl, sock);
+                        SSL_accept(ssl);
+                    }
+                    auto receive = [ssl, sock](char *buf, int size) {
+                        return ssl != nullptr ? SSL_read(ssl, buf, size) : static_cast<int>(recv(sock, buf, size, 0));
+                    };
+
+                    std::string request;
+                    char buf[4096];
+                    int n;
+                    while (request.find("\r\n\r\n") == std::string::npos && (n = receive(buf, sizeof(buf))) > 0)
+                        request.append(buf, static_cast<size_t>(n));
+
+                    if (!response.empty()) {
+                        if (ssl != nullptr)
+                            SSL_write(ssl, response.data(), static_cast<int>(response.size()));
+                        else
+                            send(sock, response.data(), response.size(), MSG_NOSIGNAL);
+                    }
+                    if (!closeAfter) {
+                        while (receive(buf, sizeof(buf)) > 0) {}
+                    }
+
+                    if (ssl != nullptr) {
+                        SSL_shutdown(ssl);
+                        SSL_free(ssl);
+                        SSL_CTX_free(ctx);
+                    }
+                    ::close(sock);
+                });
+            }
+
+            ~Server()
+            {
+                this->thread.join();
+                ::close(this->listener);
+            }
+
+            int port = 0;
+
+        private:
+            int listener;
+            std::thread thread;
+    };
+
+    KxHTTP::Endpoint endpointFor(const Server& server, bool tls = false)
+    {
+        KxHTTP::Endpoint ep;
+        ep.host = "127.0.0.1";
+        ep.port = server.port;
+        ep.tls = tls;
+        ep.options.readTimeoutMs = 200;
+        return ep;
+    }
+
+    // Sends a request and parses whatever comes back. The error message, if
+    // any, is returned so cases can check the failure they expect.
+    std::string exchange(const std::string& response, KxHTTP::Response& res, bool closeAfter = true,
+                         bool tls = false, const std::string& method = "GET")
+    {
+        Server server(response, closeAfter, tls);
+        try {
+            KxHTTP::Connection conn(endpointFor(server, tls));
+            conn.write(method + " / HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n");
+            KxHTTP::readResponse(conn, method == "HEAD", res);
+        } catch (const std::runtime_error& e) {
+            return e.what();
+        }
+        return {};
+    }
+
+    bool contains(const std::string& s, const char *part)
+    {
+        return s.find(part) != std::string::npos;
+    }
+
+    void contentLength()
+    {
+        KxHTTP::Response res;
+        CHECK(exchange("HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello", res).empty());
+        CHECK(res.status == 200);
+        CHECK(res.body == "hello");
+        CHECK(res.keepAlive);
+
+        CHECK(exchange("HTTP/1.1 200 OK\r\nContent-Length:  5 \r\n\r\nhello", res).empty());
+        CHECK(res.body == "hello");
+
+        CHECK(contains(exchange("HTTP/1.1 200 OK\r\nContent-Length: 5abc\r\n\r\nhello", res), "Malformed Content-Length"));
+        CHECK(contains(exchange("HTTP/1.1 200 OK\r\nContent-Length: \r\n\r\n", res), "Malformed Content-Length"));
+        CHECK(contains(exchange("HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nhello", res),
+                       "Connection closed before the response body was complete"));
+    }
+
+    void chunked()
+    {
+        KxHTTP::Response res;
+        CHECK(exchange("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+                       "5;ext=1\r\nhello\r\n6\r\n world\r\n0\r\nX-Trailer: 1\r\nX-Other: 2\r\n\r\n", res).empty());
+        CHECK(res.body == "hello world");
+        CHECK(res.keepAlive);
+
+        CHECK(exchange("HTTP/1.1 200 OK\r\ntransfer-encoding: CHUNKED\r\n\r\nA\r\n0123456789\r\n0\r\n\r\n", res).empty());
+        CHECK(res.body == "0123456789");
+
+        CHECK(contains(exchange("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\nhello\r\n0\r\n\r\n", res),
+                       "Malformed chunk size"));
+        CHECK(contains(exchange("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhelloXX0\r\n\r\n", res),
+                       "Malformed chunk terminator"));
+        CHECK(contains(exchange("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhel", res),
+                       "Connection closed"));
+    }
+
+    void mixedTransferCodings()
+    {
+        KxHTTP::Response res;
+
+        // Chunked last: the chunk framing is removed, the gzip coding is left to the reader
+        CHECK(exchange("HTTP/1.1 200 OK\r\nTransfer-Encoding: gzip, chunked\r\n\r\n5\r\nhello\r\n0\r\n\r\n", res).empty());
+        CHECK(res.body == "hello");
+        CHECK(res.keepAlive);
+
+        CHECK(exchange("HTTP/1.1 200 OK\r\nTransfer-Encoding: gzip\r\nTransfer-Encoding: chunked\r\n\r\n"
+                       "5\r\nhello\r\n0\r\n\r\n", res).empty());
+        CHECK(res.body == "hello");
+
+        // Anything else runs to the close, and overrides Content-Length
+        CHECK(exchange("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked, gzip\r\n\r\n5\r\nhello", res).empty());
+        CHECK(res.body == "5\r\nhello");
+        CHECK(!res.keepAlive);
+
+        CHECK(exchange("HTTP/1.1 200 OK\r\nTransfer-Encoding: gzip\r\nContent-Length: 2\r\n\r\nhello", res).empty());
+        CHECK(res.body == "hello");
+        CHECK(!res.keepAlive);
+    }
+
+    void closeDelimited()
+    {
+        KxHTTP::Response res;
+        CHECK(exchange("HTTP/1.1 200 OK\r\nConnection: close\r\n\r\nuntil the end", res).empty());
+        CHECK(res.body == "until the end");
+        CHECK(!res.keepAlive);
+
+        CHECK(exchange("HTTP/1.0 200 OK\r\n\r\nold", res).empty());
+        CHECK(res.body == "old");
+        CHECK(!res.keepAlive);
+    }
+
+    void bodylessResponses()
+    {
+        KxHTTP::Response res;
+        CHECK(exchange("HTTP/1.1 204 No Content\r\n\r\n", res, false).empty());
+        CHECK(res.status == 204);
+        CHECK(res.body.empty());
+
+        CHECK(exchange("HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\n", res, false, false, "HEAD").empty());
+        CHECK(res.body.empty());
+
+        // Interim responses are skipped
+        CHECK(exchange("HTTP/1.1 100 Continue\r\n\r\nHTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok", res).empty());
+        CHECK(res.status == 200);
+        CHECK(res.body == "ok");
+
+        CHECK(contains(exchange("garbage\r\n\r\n", res), "Malformed response status line"));
+    }
+
+    void timeouts()
+    {
+        KxHTTP::Response res;
+
+        // The server reads the request and never answers
+        CHECK(contains(exchange("", res, false), "Timed out reading response"));
+        CHECK(contains(exchange("HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nhel", res, false),
+                       "Timed out reading response"));
+        CHECK(contains(exchange("", res, false, true), "Timed out reading response"));
+        CHECK(contains(exchange("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhel", res, false, true),
+                       "Timed out reading response"));
+
+        // A deadline shorter than the read timeout ends the read first
+        Server server("", false);
+        auto ep = endpointFor(server);
+        ep.options.readTimeoutMs = 5000;
+        auto started = std::chrono::steady_clock::now();
+        std::string error;
+        try {
+            KxHTTP::Connection conn(ep, started + std::chrono::milliseconds(200));
+            conn.write("GET / HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n");
+            KxHTTP::readResponse(conn, false, res);
+        } catch (const std::runtime_error& e) {
+            error = e.what();
+        }
+        CHECK(!error.empty());
+        CHECK(std::chrono::steady_clock::now() - started < std::chrono::seconds(2));
+    }
+
+    void tls()
+    {
+        KxHTTP::Response res;
+        CHECK(exchange("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n0\r\n\r\n", res, true, true).empty());
+        CHECK(res.body == "hello");
+    }
+}
+
+int main()
+{
+    testCertificate();
+
+    const std::vector<std::pair<const char *, std::function<void()>>> cases = {
+        { "Content-Length", contentLength },
+        { "chunked", chunked },
+        { "mixed transfer codings", mixedTransferCodings },
+        { "close-delimited", closeDelimited },
+        { "bodyless responses", bodylessResponses },
+        { "timeouts", timeouts },
+        { "TLS", tls },
+    };
+
+    for (const auto& c : cases) {
+        int before = failures;
+        c.second();
+        std::printf("%s %s\n", failures == before ? "ok  " : "FAIL", c.first);
+    }
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}